@@ -20,8 +20,11 @@
 #include <string.h>
 
 // EPICS includes
+#include <epicsAtomic.h>
 #include <epicsExit.h>
+#include <epicsEndian.h>
 #include <epicsExport.h>
+#include <epicsMessageQueue.h>
 #include <epicsStdio.h>
 #include <epicsString.h>
 #include <epicsThread.h>
@@ -32,13 +35,31 @@
 #define H5Dopen_vers 2
 
 #include <hdf5.h>
+#ifdef ADSCANPB_WITH_BLOSC
+#include <blosc.h>
+#endif
+#ifdef ADSCANPB_WITH_BITSHUFFLE
+#include <bitshuffle.h>
+#endif
+#include <zlib.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <vector>
 
 // Area Detector include
 #include "ADScanPB.h"
@@ -75,6 +96,11 @@ const char *driverName = "ADScanPB";
 
 // Add any driver constants here
 
+// Registered IDs of the HDF5 filters whose chunks can be emitted as is
+#define ADSCANPB_H5Z_FILTER_BLOSC 32001
+#define ADSCANPB_H5Z_FILTER_BITSHUFFLE 32008
+#define ADSCANPB_BITSHUFFLE_LZ4 2
+
 // -----------------------------------------------------------------------
 // ADScanPB Utility Functions (Reporting/Logging/ExternalC)
 // -----------------------------------------------------------------------
@@ -110,6 +136,26 @@ static void playbackThreadC(void *pPvt) {
     pScanPB->playbackThread();
 }
 
+static void prefetchThreadC(void *pPvt) {
+    ADScanPB *pScanPB = (ADScanPB *)pPvt;
+    pScanPB->prefetchThread();
+}
+
+static void pipelineThreadC(void *pPvt) {
+    ADScanPB *pScanPB = (ADScanPB *)pPvt;
+    pScanPB->pipelineThread();
+}
+
+static void loaderThreadC(void *pPvt) {
+    ADScanPB *pScanPB = (ADScanPB *)pPvt;
+    pScanPB->loaderThread();
+}
+
+static void playlistThreadC(void *pPvt) {
+    ADScanPB *pScanPB = (ADScanPB *)pPvt;
+    pScanPB->playlistThread();
+}
+
 void ADScanPB::updateStatus(const char *msg, ADScanPBErr_t errLevel) {
     const char *functionName = "updateStatus";
     switch (errLevel) {
@@ -142,9 +188,10 @@ asynStatus ADScanPB::acquireStart() {
     const char *functionName = "acquireStart";
     asynStatus status = asynSuccess;
 
-    int scanLoaded;
+    int scanLoaded, progressive;
     getIntegerParam(ADScanPB_ScanLoaded, &scanLoaded);
-    if (scanLoaded != 1) {
+    getIntegerParam(ADScanPB_ProgressivePlayback, &progressive);
+    if (scanLoaded != 1 && !(this->loading && progressive == 1)) {
         updateStatus("Scan has not been loaded for playback!", ADSCANPB_ERR);
         status = asynError;
     }
@@ -174,54 +221,98 @@ void ADScanPB::playbackThread() {
 
     NDArray *pArray;
     NDArrayInfo arrayInfo;
-    int dataType, imageMode, colorMode, ndims, autoRepeat, nframes, arrayCallbacks, trigSignal;
+    int imageMode, autoRepeat, nframes, arrayCallbacks, trigSignal;
     ADScanPBTrigMode_t trigMode;
     ADScanPBTrigEdge_t trigEdge;
     ADScanPBTTLSignal_t idleSignal, busySignal;
+
+    // If playback was started while the scan is still loading, wait for the first frames. The
+    // scan dimensions are only known once the loader has produced some frames.
+    int progressiveMinFrames;
+    getIntegerParam(ADScanPB_ProgressiveMinFrames, &progressiveMinFrames);
+    if (progressiveMinFrames < 1) progressiveMinFrames = 1;
+    if (this->loading && this->loadedFrontier < progressiveMinFrames) {
+        LOG("Waiting for initial frames to load...");
+        while (this->playback && this->loading && this->loadedFrontier < progressiveMinFrames)
+            epicsEventWaitWithTimeout(this->loadProgressEventId, 0.1);
+    }
+    if (!this->playback) return;
+    if (this->loadedFrontier == 0) {
+        updateStatus("Scan failed to load, stopping playback", ADSCANPB_ERR);
+        this->playback = false;
+        setIntegerParam(ADAcquire, 0);
+        setIntegerParam(ADStatus, ADStatusIdle);
+        callParamCallbacks();
+        return;
+    }
+
     getIntegerParam(ADScanPB_IdleReadySignal, (int*) &idleSignal);
     if (idleSignal == ADSCANPB_SIGNAL_HIGH)
         busySignal = ADSCANPB_SIGNAL_LOW;
     else
         busySignal = ADSCANPB_SIGNAL_HIGH;
 
-    clock_t start, end;
-    double playbackTime;
-
     // Three different frame counters.
     int playbackPos, imageCounter, totalImageCounter;
 
-    getIntegerParam(NDColorMode, &colorMode);
-    getIntegerParam(NDDataType, &dataType);
-
     getIntegerParam(ADImageMode, &imageMode);
     getIntegerParam(ADScanPB_NumFrames, &nframes);
 
     getIntegerParam(ADTriggerMode, (int *)&trigMode);
     getIntegerParam(ADScanPB_TriggerEdge, (int *)&trigEdge);
 
-    int width, height;
-    getIntegerParam(ADMaxSizeX, &width);
-    getIntegerParam(ADMaxSizeY, &height);
+    ADScanPBFrameFormat_t frameFormat;
+    getFrameFormat(&frameFormat);
 
-    if ((NDColorMode_t)colorMode == NDColorModeMono)
-        ndims = 2;
-    else
-        ndims = 3;
+    // Optionally prepare upcoming frames on a separate thread while this one waits to emit
+    getIntegerParam(ADScanPB_PlaybackPos, &playbackPos);
+    this->playbackPosRequest = -1;
 
-    size_t dims[ndims];
-    if (ndims == 2) {
-        dims[0] = width;
-        dims[1] = height;
-    } else {
-        dims[0] = 3;
-        dims[1] = width;
-        dims[2] = height;
-    }
+    int pipelineDepth;
+    getIntegerParam(ADScanPB_PipelineDepth, &pipelineDepth);
+    if (pipelineDepth > 0) startPipeline(pipelineDepth, frameFormat, playbackPos, nframes);
 
     bool acqStarted = false;
 
+    // Sustained playback rate is measured over windows of roughly one second
+    int framesInRateWindow = 0;
+    epicsUInt64 rateWindowStart = epicsMonotonicGet();
+
+    // Frames are emitted on an absolute schedule taken from the monotonic clock, so time spent
+    // preparing each frame does not accumulate as drift. The schedule is restarted whenever
+    // playback had to wait on something other than the clock.
+    bool rebaseSchedule = true;
+    epicsUInt64 frameDeadline = 0;
+    int lastEmittedPos = -1;
+
+    int playbackTiming;
+    getIntegerParam(ADScanPB_PlaybackTiming, &playbackTiming);
+    if (playbackTiming == ADSCANPB_TIMING_TIMESTAMPS && this->scan->timestampData == NULL)
+        updateStatus("No timestamps loaded, playing back at fixed rate", ADSCANPB_WARN);
+    int pacedFramesInWindow = 0;
+    double latenessSumUs = 0, maxJitterUs = 0;
+    double bytesInRateWindow = 0;
+
+    // Unthrottled playback can be bounded to a fixed number of frames or a fixed duration, in
+    // which case the averages over the whole burst are reported when it completes
+    bool unthrottled = playbackTiming == ADSCANPB_TIMING_UNTHROTTLED;
+    int burstFrameLimit;
+    double burstDurationLimit;
+    getIntegerParam(ADScanPB_BurstFrames, &burstFrameLimit);
+    getDoubleParam(ADScanPB_BurstDuration, &burstDurationLimit);
+    int burstFrames = 0;
+    double burstBytes = 0;
+    epicsUInt64 burstStart = epicsMonotonicGet();
+
+    this->allocFailures = 0;
+    setIntegerParam(ADScanPB_AllocFailures, 0);
+
+    // Set once playback has wrapped around to the start of the scan, and the number of passes
+    // made through the current scan
+    bool passEnded = false;
+    int passes = 0;
+
     while (playback) {
-        start = clock();
         int lastSignal;
         getIntegerParam(ADScanPB_TriggerSignal, &trigSignal);
         lastSignal = trigSignal;
@@ -250,6 +341,7 @@ void ADScanPB::playbackThread() {
                 }
 
                 acqStarted = true;
+                rebaseSchedule = true;
                 this->waitingForTriggerEvent = false;
                 LOG_ARGS("Recieved %s edge trigger.",
                          trigEdge == ADSCANPB_EDGE_RISING ? "rising" : "falling");
@@ -258,41 +350,103 @@ void ADScanPB::playbackThread() {
         setIntegerParam(ADScanPB_ReadySignal, (int) busySignal);
 
         double spf;
+        int autoSwap;
         getIntegerParam(ADScanPB_AutoRepeat, &autoRepeat);
+        getIntegerParam(ADScanPB_AutoSwap, &autoSwap);
         getDoubleParam(ADAcquirePeriod, &spf);
-        getIntegerParam(ADScanPB_PlaybackPos, &playbackPos);
-        LOG_ARGS("Playing back frame %d from scan...", playbackPos);
-
-        // allocate memory for a new NDArray, and set pArray to a pointer for this memory
-        this->pArrays[0] = pNDArrayPool->alloc(ndims, dims, (NDDataType_t)dataType, 0, NULL);
-
-        if (this->pArrays[0] != NULL) {
-            pArray = this->pArrays[0];
-        } else {
-            this->pArrays[0]->release();
-            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s Unable to allocate array\n",
-                      driverName, functionName);
-            return;
+        // Unthrottled playback takes the measured rate below
+        if (!unthrottled && spf > 0) this->streamRateFPS = 1.0 / spf;
+
+        // Switch to the preloaded next scan at this frame boundary if asked to, or automatically
+        // once the current scan or playlist entry has been played through. Frames of the
+        // outgoing scan that the pipeline prepared ahead are discarded.
+        bool entryDone = passEnded && playlistEntryDone(passes);
+        if (this->nextScanReady &&
+            (this->swapRequested || (passEnded && autoSwap == 1) || entryDone)) {
+            stopPipeline();
+            // Swapped holding the port lock, as by the loader and writeInt32. Acquisition may
+            // have been stopped while waiting for it, in which case the scan is left as it is.
+            lock();
+            if (!this->playback) {
+                unlock();
+                break;
+            }
+            if (swapNextScan()) {
+                getIntegerParam(ADScanPB_NumFrames, &nframes);
+                getFrameFormat(&frameFormat);
+                playbackPos = 0;
+                lastEmittedPos = -1;
+                passes = 0;
+                setIntegerParam(ADScanPB_PlaylistPass, 1);
+            }
+            unlock();
+            // Pace the new scan from here rather than bursting to make up for the swap
+            rebaseSchedule = true;
+            if (pipelineDepth > 0)
+                startPipeline(pipelineDepth, frameFormat, playbackPos, nframes);
+        } else if (entryDone && this->playlistNextEntry != this->scan->playlistEntry) {
+            // The next entry is still loading, keep repeating this one rather than leave a gap
+            this->playlistUnderruns++;
+            setIntegerParam(ADScanPB_PlaylistUnderruns, this->playlistUnderruns);
+            WARN("Next playlist entry not loaded yet, repeating current entry");
         }
+        passEnded = false;
+        // The position is tracked locally, so that writes to it are not lost to this thread
+        // writing back the incremented position
+        int requestedPos = this->playbackPosRequest.exchange(-1);
+        if (requestedPos >= 0) playbackPos = requestedPos < nframes ? requestedPos : 0;
+        LOG_ARGS("Playing back frame %d from scan...", playbackPos);
 
-        updateTimeStamp(&pArray->epicsTS);
-
-        size_t num_elems = 1;
-        for (int i = 0; i < ndims; i++) {
-            num_elems = num_elems * dims[i];
+        // Only wait on the loader if playback has overtaken the loaded frontier. With the
+        // pipeline enabled, the pipeline thread waits on the loader instead.
+        while (this->playback && this->loading && this->pipelineQueue == NULL &&
+               playbackPos >= this->loadedFrontier) {
+            epicsEventWaitWithTimeout(this->loadProgressEventId, 0.1);
+            rebaseSchedule = true;
         }
-
-        size_t totalBytes = num_elems;
-        if (dataType == NDUInt8) {
-            memcpy(pArray->pData,
-                   (uint8_t *)this->scanImageDataBuffer + (num_elems * (playbackPos)), num_elems);
-        } else {
-            totalBytes = totalBytes * 2;
-            memcpy(pArray->pData,
-                   (uint16_t *)this->scanImageDataBuffer + (num_elems * (playbackPos)), totalBytes);
+        if (!this->playback) break;
+        epicsUInt64 frameStart = epicsMonotonicGet();
+
+        if (this->pipelineQueue != NULL)
+            pArray = receivePipelineFrame(playbackPos);
+        else
+            pArray = prepareFrame(playbackPos, frameFormat);
+
+        if (pArray == NULL) {
+            // Acquisition was stopped while waiting for the frame
+            if (!this->playback) break;
+
+            // The pool is exhausted because downstream plugins are holding on to arrays. Drop
+            // this frame, as a detector would, and carry on with the next one.
+            this->allocFailures++;
+            setIntegerParam(ADScanPB_AllocFailures, this->allocFailures);
+            WARN_ARGS("Unable to allocate array, dropping frame %d", playbackPos);
+            playbackPos++;
+            if (playbackPos == nframes) {
+                playbackPos = 0;
+                passEnded = true;
+                passes++;
+                setIntegerParam(ADScanPB_PlaylistPass, passes + 1);
+                if (!continuePlayback(autoRepeat, autoSwap, passes)) playback = false;
+            }
+            if (unthrottled && burstDurationLimit > 0 &&
+                (epicsMonotonicGet() - burstStart) / 1.0e9 >= burstDurationLimit)
+                playback = false;
+
+            setIntegerParam(ADScanPB_PlaybackPos, playbackPos);
+            if (!playback) {
+                setIntegerParam(ADAcquire, 0);
+                setIntegerParam(ADStatus, ADStatusIdle);
+            }
+            callParamCallbacks();
+            continue;
         }
+        this->pArrays[0] = pArray;
 
-        pArray->pAttributeList->add("ColorMode", "Color Mode", NDAttrInt32, &colorMode);
+        pArray->getInfo(&arrayInfo);
+        size_t totalBytes = arrayInfo.totalBytes;
+        // Compressed arrays only move their compressed size downstream
+        if (!pArray->codec.empty()) totalBytes = pArray->compressedSize;
 
         getIntegerParam(NDArrayCounter, &imageCounter);
         imageCounter++;
@@ -303,24 +457,36 @@ void ADScanPB::playbackThread() {
         setIntegerParam(ADNumImagesCounter, totalImageCounter);
         pArray->uniqueId = totalImageCounter;
 
-        setIntegerParam(NDArraySizeX, width);
-        setIntegerParam(NDArraySizeY, height);
+        setIntegerParam(NDArraySizeX, arrayInfo.xSize);
+        setIntegerParam(NDArraySizeY, arrayInfo.ySize);
         setIntegerParam(NDArraySize, totalBytes);
+        setStringParam(NDCodec, pArray->codec.name);
+        setIntegerParam(NDCompressedSize, pArray->compressedSize);
+
+        // Unless we are in gated exposure mode, wait for the desired exposure time. Unthrottled
+        // playback emits the frame as soon as it is ready.
+        if (trigMode != ADSCANPB_TRIG_EXP_GATE && unthrottled) {
+            rebaseSchedule = true;
+        } else if(trigMode != ADSCANPB_TRIG_EXP_GATE) {
+            epicsUInt64 periodNs = getFramePeriodNs(playbackPos, lastEmittedPos, spf);
+            if (rebaseSchedule) {
+                frameDeadline = frameStart + periodNs;
+                rebaseSchedule = false;
+            } else {
+                frameDeadline += periodNs;
+                // After a long stall restart the schedule rather than bursting to catch up
+                if (frameStart > frameDeadline + PACING_MAX_CATCHUP_FRAMES * periodNs)
+                    frameDeadline = frameStart + periodNs;
+            }
 
-        // If we don't have a timestamp buffer loaded, create new timestamp
-        if (this->scanTimestampDataBuffer == NULL) {
-            pArray->timeStamp =
-                (double)pArray->epicsTS.secPastEpoch + ((double)pArray->epicsTS.nsec * 1.0e-9);
-        } else {
-            pArray->timeStamp = *((double *)this->scanTimestampDataBuffer + playbackPos);
-        }
-
-        end = clock();
-        playbackTime = ((double)(end - start)) / CLOCKS_PER_SEC;
+            double spinTailUs;
+            getDoubleParam(ADScanPB_PacingSpinTail, &spinTailUs);
+            waitForDeadline(frameDeadline, (epicsUInt64)(spinTailUs * 1000));
 
-        // Unless we are in gated exposure mode, wait for the desired exposure time.
-        if(trigMode != ADSCANPB_TRIG_EXP_GATE) {
-            epicsThreadSleep(spf - playbackTime);
+            double latenessUs = ((double)epicsMonotonicGet() - (double)frameDeadline) / 1000.0;
+            if (latenessUs > 0) latenessSumUs += latenessUs;
+            if (fabs(latenessUs) > maxJitterUs) maxJitterUs = fabs(latenessUs);
+            pacedFramesInWindow++;
         }
         else {
             // if we are in gated exposure mode, wait for opposite edge
@@ -332,12 +498,81 @@ void ADScanPB::playbackThread() {
                     eventRecd = epicsEventWaitWithTimeout(this->risingEdgeEventId, TRIG_TIMEOUT);
                 if(!playback) break;
             }           
+            rebaseSchedule = true;
+        }
+
+        // Timestamp the frame when it is emitted rather than when it was prepared
+        updateTimeStamp(&pArray->epicsTS);
+
+        // If we don't have a timestamp for the frame loaded, create new timestamp
+        if (this->scan->timestampData == NULL || playbackPos >= this->scan->numTimestamps) {
+            pArray->timeStamp =
+                (double)pArray->epicsTS.secPastEpoch + ((double)pArray->epicsTS.nsec * 1.0e-9);
+        } else {
+            pArray->timeStamp = *((double *)this->scan->timestampData + playbackPos);
         }
 
         getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
         if (arrayCallbacks) doCallbacksGenericPointer(pArray, NDArrayData, 0);
 
         pArray->release();
+        setIntegerParam(ADScanPB_ZeroCopyOutstanding, this->zeroCopyPool->getNumOutstanding());
+        lastEmittedPos = playbackPos;
+
+        framesInRateWindow++;
+        bytesInRateWindow += totalBytes;
+        double rateWindowElapsed = (epicsMonotonicGet() - rateWindowStart) / 1.0e9;
+        if (rateWindowElapsed >= 1.0) {
+            setDoubleParam(ADScanPB_MeasuredFPS, framesInRateWindow / rateWindowElapsed);
+            setDoubleParam(ADScanPB_MeasuredGBps, bytesInRateWindow / rateWindowElapsed / 1.0e9);
+            publishKernelStats();
+            // Unthrottled playback asks for as many frames as it can get
+            double measuredFPS = framesInRateWindow / rateWindowElapsed;
+            if (unthrottled || spf <= 0) this->streamRateFPS = measuredFPS;
+            if (this->compressedFrames != NULL) publishDecompressStats(this->streamRateFPS);
+            if (this->tiledStreaming) {
+                publishTiledStreamStats((playbackPos + 1) % nframes);
+                publishTiledStats();
+            }
+            if (pacedFramesInWindow > 0) {
+                setDoubleParam(ADScanPB_PacingLateness, latenessSumUs / pacedFramesInWindow);
+                setDoubleParam(ADScanPB_PacingJitter, maxJitterUs);
+            }
+            pacedFramesInWindow = 0;
+            latenessSumUs = 0;
+            maxJitterUs = 0;
+            framesInRateWindow = 0;
+            bytesInRateWindow = 0;
+            rateWindowStart = epicsMonotonicGet();
+        }
+
+        if (unthrottled) {
+            burstFrames++;
+            burstBytes += totalBytes;
+            double burstElapsed = (epicsMonotonicGet() - burstStart) / 1.0e9;
+            if ((burstFrameLimit > 0 && burstFrames >= burstFrameLimit) ||
+                (burstDurationLimit > 0 && burstElapsed >= burstDurationLimit))
+                playback = false;
+        }
+
+        if (this->prefetchRing != NULL) {
+            epicsMutexLock(this->prefetchMutex);
+            int prefetchLevel = 0;
+            for (int i = 0; i < this->prefetchRingDepth; i++) {
+                if (this->prefetchRing[i].frame >= 0 && this->prefetchRing[i].ready)
+                    prefetchLevel++;
+            }
+            epicsMutexUnlock(this->prefetchMutex);
+            setIntegerParam(ADScanPB_PrefetchLevel, prefetchLevel);
+            setIntegerParam(ADScanPB_StreamStalls, this->prefetchStalls);
+        }
+
+        if (this->pipelineQueue != NULL) {
+            setIntegerParam(ADScanPB_PipelineOccupancy,
+                            epicsMessageQueuePending(this->pipelineQueue));
+            setIntegerParam(ADScanPB_PipelineStalls, this->pipelineStalls);
+            setIntegerParam(ADScanPB_AllocFailures, this->allocFailures);
+        }
 
         playbackPos++;
 
@@ -353,7 +588,10 @@ void ADScanPB::playbackThread() {
 
         if (playbackPos == nframes) {
             playbackPos = 0;
-            if (autoRepeat != 1) playback = false;
+            passEnded = true;
+            passes++;
+            setIntegerParam(ADScanPB_PlaylistPass, passes + 1);
+            if (!continuePlayback(autoRepeat, autoSwap, passes)) playback = false;
         }
 
         setIntegerParam(ADScanPB_PlaybackPos, playbackPos);
@@ -364,6 +602,78 @@ void ADScanPB::playbackThread() {
         }
         callParamCallbacks();
     }
+
+    stopPipeline();
+    publishKernelStats();
+    callParamCallbacks();
+
+    if (unthrottled && burstFrames > 0) {
+        double burstElapsed = (epicsMonotonicGet() - burstStart) / 1.0e9;
+        double burstFPS = burstFrames / burstElapsed;
+        double burstGBps = burstBytes / burstElapsed / 1.0e9;
+        setDoubleParam(ADScanPB_MeasuredFPS, burstFPS);
+        setDoubleParam(ADScanPB_MeasuredGBps, burstGBps);
+        setIntegerParam(ADScanPB_AllocFailures, this->allocFailures);
+
+        char msg[256];
+        epicsSnprintf(msg, sizeof(msg), "Burst of %d frames in %.3f s, %.1f fps, %.3f GB/s",
+                      burstFrames, burstElapsed, burstFPS, burstGBps);
+        updateStatus(msg, ADSCANPB_LOG);
+        callParamCallbacks();
+    }
+}
+
+/**
+ * @brief Computes the time between emitting the previous frame and the given frame. In fixed
+ * rate timing this is the acquire period. In timestamp timing it is the original inter-frame
+ * delta from the timestamp dataset, scaled by the playback speed and optionally clamped, falling
+ * back to the acquire period when the frames are not consecutive (e.g. on wrap around).
+ *
+ * @param frame Index of the frame about to be emitted
+ * @param previousFrame Index of the last emitted frame, -1 if none
+ * @param spf Acquire period in seconds
+ * @return Frame period in nanoseconds
+ */
+epicsUInt64 ADScanPB::getFramePeriodNs(int frame, int previousFrame, double spf) {
+    double period = spf;
+
+    int playbackTiming;
+    getIntegerParam(ADScanPB_PlaybackTiming, &playbackTiming);
+    if (playbackTiming == ADSCANPB_TIMING_TIMESTAMPS && this->scan->timestampData != NULL &&
+        previousFrame >= 0 && frame == previousFrame + 1 && frame < this->scan->numTimestamps) {
+        double speed, maxGap;
+        getDoubleParam(ADScanPB_PlaybackSpeed, &speed);
+        getDoubleParam(ADScanPB_MaxGap, &maxGap);
+
+        const double *timestamps = (const double *)this->scan->timestampData;
+        if (speed <= 0) speed = 1;
+        period = (timestamps[frame] - timestamps[previousFrame]) / speed;
+        if (maxGap > 0 && period > maxGap) period = maxGap;
+    }
+
+    return period > 0 ? (epicsUInt64)(period * 1.0e9) : 0;
+}
+
+/**
+ * @brief Waits until an absolute deadline on the monotonic clock. Sleeps for all but the final
+ * spinTailNs of the wait, which is busy-waited for sub-millisecond accuracy. Returns early if
+ * playback is stopped.
+ *
+ * @param deadline Deadline as returned by epicsMonotonicGet
+ * @param spinTailNs Length of the busy-wait tail in nanoseconds, 0 to only sleep
+ */
+void ADScanPB::waitForDeadline(epicsUInt64 deadline, epicsUInt64 spinTailNs) {
+    while (this->playback) {
+        epicsUInt64 now = epicsMonotonicGet();
+        if (now >= deadline) break;
+
+        epicsUInt64 remaining = deadline - now;
+        if (remaining > spinTailNs) {
+            // Sleep in bounded steps so that a stop request is noticed on long frame periods
+            double sleepTime = (remaining - spinTailNs) / 1.0e9;
+            epicsThreadSleep(sleepTime < 0.1 ? sleepTime : 0.1);
+        }
+    }
 }
 
 /**
@@ -377,10 +687,13 @@ asynStatus ADScanPB::acquireStop() {
     const char *functionName = "acquireStop";
     asynStatus status = asynSuccess;
 
-    // Stop acquistion and join back the playback thread
+    // Stop acquistion and join back the playback thread, with the port unlocked since the
+    // playback thread takes the lock to swap in the next scan
     if (this->playback) {
         this->playback = false;
+        unlock();
         epicsThreadMustJoin(this->playbackThreadId);
+        lock();
     }
 
     setIntegerParam(ADStatus, ADStatusIdle);
@@ -450,8 +763,46 @@ asynStatus ADScanPB::writeInt32(asynUser *pasynUser, epicsInt32 value) {
         if (!value && acquiring) {
             status = acquireStop();
         }
+    } else if (function == ADScanPB_CacheMaxSize) {
+        evictScanCache(string());
+    } else if (function == ADScanPB_TiledCacheMaxSize) {
+        // Applies to a scan that is already streaming from the next block fetched
+        epicsMutexLock(this->tiledStreamMutex);
+        this->tiledCacheMaxBytes = (size_t)std::max(value, 0) * 1000000;
+        epicsMutexUnlock(this->tiledStreamMutex);
+    } else if (function == ADScanPB_CancelLoad) {
+        if (value == 1) cancelLoad();
+        setIntegerParam(ADScanPB_CancelLoad, 0);
+    } else if (function == ADScanPB_SwapScan) {
+        // While playing back, the playback thread swaps at the next frame boundary. Otherwise the
+        // swap is made now, or as soon as the next scan has loaded.
+        if (value == 1) {
+            this->swapRequested = true;
+            if (!this->playback) swapNextScan();
+        }
+        setIntegerParam(ADScanPB_SwapScan, 0);
+    } else if (function == ADScanPB_PlaylistEnable) {
+        if (value == 1)
+            status = startPlaylist();
+        else
+            stopPlaylist();
+        if (status != asynSuccess) setIntegerParam(ADScanPB_PlaylistEnable, 0);
+    } else if (function == ADScanPB_ZeroCopy) {
+        // The previous entry is kept for as long as zero-copy arrays reference it, which with
+        // frames always in flight would hold back the preload of the entry after it forever
+        if (value == 1 && this->playlistActive) {
+            updateStatus("Cannot enable zero-copy while a playlist is playing!", ADSCANPB_ERR);
+            setIntegerParam(ADScanPB_ZeroCopy, 0);
+            status = asynError;
+        }
+    } else if (function == ADScanPB_PlaylistLoop) {
+        // Looping may let a playlist that had reached its last entry go on
+        if (this->playlistActive) epicsEventSignal(this->playlistEventId);
+    } else if (function == ADScanPB_PlaybackPos) {
+        this->playbackPosRequest = value;
     } else if (function == ADScanPB_ResetPlaybackPos) {
         setIntegerParam(ADScanPB_PlaybackPos, 0);
+        this->playbackPosRequest = 0;
     } else if (function == ADImageMode) {
         if (acquiring == 1) acquireStop();
     } else if (function == ADScanPB_DataSource) {
@@ -549,6 +900,11 @@ asynStatus ADScanPB::writeFloat64(asynUser *pasynUser, epicsFloat64 value) {
 
     if (function == ADScanPB_PlaybackRateFPS || function == ADAcquirePeriod || function == ADAcquireTime) {
         setPlaybackRate(function);
+    } else if (function == ADScanPB_PlaybackSpeed) {
+        if (value < 0.1) setDoubleParam(function, 0.1);
+        else if (value > 100) setDoubleParam(function, 100);
+    } else if (function == ADScanPB_TiledPrefetchTime) {
+        this->tiledPrefetchTime = value;
     } else {
         if (function < ADSCANPB_FIRST_PARAM) {
             status = ADDriver::writeFloat64(pasynUser, value);
@@ -568,188 +924,3588 @@ void ADScanPB::closeScan() {
     // If acquiring, stop acquiring first.
     if (this->playback) acquireStop();
 
-    // clear out buffers if they have been allocated
-    if (this->scanImageDataBuffer != NULL) free(this->scanImageDataBuffer);
-
-    if (this->scanTimestampDataBuffer != NULL) free(this->scanTimestampDataBuffer);
+    releaseScanStorage();
+    freeScanBuffer(this->scan);
 
+    this->loadedFrontier = 0;
     setIntegerParam(ADScanPB_ScanLoaded, 0);
     setDoubleParam(ADScanPB_LoadPercent, 0);
     setIntegerParam(ADScanPB_NumFramesLoaded, 0);
+    setIntegerParam(ADScanPB_SharedAttached, 0);
+    setIntegerParam(ADScanPB_SharedUsers, 0);
     callParamCallbacks();
 }
 
-asynStatus ADScanPB::openScanTiled(const char *scanID) {
-    const char *functionName = "openScanTiled";
-    asynStatus status = asynSuccess;
-
-    char tiledServerURL[256], metadataURL[512], imageDataset[256], dataPath[256];
-    getStringParam(ADScanPB_TiledServerURL, 256, tiledServerURL);
-    getStringParam(ADScanPB_ExternalPath, 256, dataPath);
-    getStringParam(ADScanPB_ImageDataset, 256, imageDataset);
-    snprintf(metadataURL, 512, "%s/api/v1/metadata/%s/%s/%s", tiledServerURL, dataPath, scanID, imageDataset);
-
-    if (this->tiledApiKey == NULL)
-        updateStatus("No tiled API key was found!", ADSCANPB_WARN);
-
-    LOG_ARGS("Attempting to load img data from scan w/ ID: %s from %s/%s", scanID, tiledServerURL, dataPath);
+/**
+ * @brief Stops streaming from the scan file and frees the compressed store of the active scan.
+ * Scans held in memory are left loaded.
+ */
+void ADScanPB::releaseScanStorage() {
+    // Stop the streaming reader before closing the file it reads from, aborting any Tiled block
+    // downloads in progress
+    this->tiledStreamStop = true;
+    stopPrefetch();
+    stopTiledStream();
+    {
+        std::lock_guard<std::mutex> guard(this->h5Mutex);
+        if (this->streamDtypeId >= 0) H5Tclose(this->streamDtypeId);
+        if (this->streamDatasetId >= 0) H5Dclose(this->streamDatasetId);
+        if (this->streamFileId >= 0) H5Fclose(this->streamFileId);
+    }
+    this->streamDtypeId = -1;
+    this->streamDatasetId = -1;
+    this->streamFileId = -1;
+    freeCompressedStore();
+}
 
-    cpr::Response r;
-    if (this->tiledApiKey == NULL) {
-        r = cpr::Get(cpr::Url{string(metadataURL)});
+/**
+ * @brief Frees the frames and timestamps of a scan if they have been allocated, or unmaps them if
+ * opened from the cache or a shared memory segment, and resets the buffer to empty
+ *
+ * @param buffer Scan buffer to free
+ */
+void ADScanPB::freeScanBuffer(ADScanPBScanBuffer_t *buffer) {
+    detachSharedScan(buffer);
+    if (buffer->mapping != NULL) {
+        munmap(buffer->mapping, buffer->mappingSize);
     } else {
-        cpr::Header auth = cpr::Header{{string("Authorization"), "Apikey " + string(this->tiledApiKey)}};
-        r = cpr::Get(cpr::Url{string(metadataURL)}, auth);
+        if (buffer->imageData != NULL) free(buffer->imageData);
+        if (buffer->timestampData != NULL) free(buffer->timestampData);
     }
+    *buffer = ADScanPBScanBuffer_t();
+}
 
-    if (r.status_code != 200) {
-        updateStatus(r.text.c_str(), ADSCANPB_ERR);
+/**
+ * @brief Records the shape of the scan being loaded. The shape params are only updated if the
+ * scan is loaded as the active scan, a preloaded scan publishes its shape once swapped in.
+ *
+ * @param numFrames Number of frames in the scan
+ * @param sizeX Width of each frame
+ * @param sizeY Height of each frame
+ * @param colorMode NDColorMode_t of the frames
+ * @param dataType NDDataType_t of the frames
+ */
+void ADScanPB::setScanShape(int numFrames, int sizeX, int sizeY, int colorMode, int dataType) {
+    this->loadTarget->numFrames = numFrames;
+    this->loadTarget->sizeX = sizeX;
+    this->loadTarget->sizeY = sizeY;
+    this->loadTarget->colorMode = colorMode;
+    this->loadTarget->dataType = dataType;
+    if (this->loadTarget == this->scan) publishScanShape(true);
+}
+
+/**
+ * @brief Resolves the frames of the dataset being loaded that were selected with the FirstFrame,
+ * LastFrame and FrameStride PVs. A LastFrame of -1, or past the end of the dataset, selects up to
+ * its last frame.
+ *
+ * @param datasetFrames Number of frames in the source dataset
+ * @param numSelected Set to the number of frames selected
+ * @return asynError if the selection holds no frames of the dataset
+ */
+asynStatus ADScanPB::selectFrames(int datasetFrames, int *numSelected) {
+    const char *functionName = "selectFrames";
+
+    int first = this->loadTarget->sourceFirstFrame;
+    int last;
+    getIntegerParam(ADScanPB_LastFrame, &last);
+    if (last < 0 || last >= datasetFrames) last = datasetFrames - 1;
+    if (first < 0 || first > last) {
+        ERR_ARGS("Frames %d to %d selected from a scan of %d frames", first, last,
+                 datasetFrames);
+        updateStatus("Selected frames are outside of the scan!", ADSCANPB_ERR);
         return asynError;
     }
 
-    //cout << r.text << endl;
+    *numSelected = (last - first) / this->loadTarget->sourceFrameStride + 1;
+    if (*numSelected < datasetFrames)
+        LOG_ARGS("Loading %d of %d frames, from frame %d in steps of %d", *numSelected,
+                 datasetFrames, first, this->loadTarget->sourceFrameStride);
+    return asynSuccess;
+}
 
-    json metadata_j = json::parse(r.text.c_str());
-    json scanShape = metadata_j["data"]["attributes"]["structure"]["shape"];
-    
-    size_t numFrames = scanShape[0].get<size_t>();
-    size_t ySize = scanShape[1].get<size_t>();
-    size_t xSize = scanShape[2].get<size_t>();
-    size_t bytesPerElem =
-        metadata_j["data"]["attributes"]["structure"]["data_type"]["itemsize"].get<size_t>();
-    json chunks = metadata_j["data"]["attributes"]["structure"]["chunks"];
+/**
+ * @brief Updates the params describing the shape of the active scan
+ *
+ * @param resetSize Whether to reset the region of interest to the full frame
+ */
+void ADScanPB::publishScanShape(bool resetSize) {
+    setIntegerParam(ADScanPB_NumFrames, this->scan->numFrames);
+    setIntegerParam(ADMaxSizeX, this->scan->sizeX);
+    setIntegerParam(ADMaxSizeY, this->scan->sizeY);
+    if (resetSize) {
+        setIntegerParam(ADSizeX, this->scan->sizeX);
+        setIntegerParam(ADSizeY, this->scan->sizeY);
+    }
+    setIntegerParam(NDColorMode, this->scan->colorMode);
+    setIntegerParam(NDDataType, this->scan->dataType);
+}
 
-    string dataURL = metadata_j["data"]["links"]["block"];
-    char *dataURLToken = strtok((char *)dataURL.c_str(), "?");
-    dataURL = string(dataURLToken);
-    cout << dataURL << endl;
+//-------------------------------------------------------------------------
+// ADScanPB Frame Pipeline
+//-------------------------------------------------------------------------
 
-    // determine whether or not the image data is in color or not.
-    // if(colorChannels == 3){
-    //    setIntegerParam(NDColorMode, NDColorModeRGB1);
-    //} else {
-    setIntegerParam(NDColorMode, NDColorModeMono);
-    //}
+/**
+ * @brief Builds the layout of the emitted arrays from the loaded scan, the ADBase geometry params
+ * and the output data type. The region of interest and binning are clamped to the scan
+ * dimensions, and the clamped values are written back to their params, as a detector would.
+ *
+ * @param format Filled with the layout of the emitted arrays
+ */
+void ADScanPB::getFrameFormat(ADScanPBFrameFormat_t *format) {
+    int dataType, colorMode, maxSizeX, maxSizeY, minX, minY, sizeX, sizeY, binX, binY;
+    int reverseX, reverseY, zeroCopy;
+    getIntegerParam(NDDataType, &dataType);
+    getIntegerParam(NDColorMode, &colorMode);
+    getIntegerParam(ADMaxSizeX, &maxSizeX);
+    getIntegerParam(ADMaxSizeY, &maxSizeY);
+    getIntegerParam(ADMinX, &minX);
+    getIntegerParam(ADMinY, &minY);
+    getIntegerParam(ADSizeX, &sizeX);
+    getIntegerParam(ADSizeY, &sizeY);
+    getIntegerParam(ADBinX, &binX);
+    getIntegerParam(ADBinY, &binY);
+    getIntegerParam(ADReverseX, &reverseX);
+    getIntegerParam(ADReverseY, &reverseY);
+    getIntegerParam(ADScanPB_ZeroCopy, &zeroCopy);
+
+    int outputDataType;
+    ADScanPBConversion_t &conversion = format->conversion;
+    getIntegerParam(ADScanPB_OutputDataType, &outputDataType);
+    getDoubleParam(ADScanPB_ConvertScale, &conversion.scale);
+    getDoubleParam(ADScanPB_ConvertOffset, &conversion.offset);
+    if (outputDataType == ADSCANPB_OUTPUT_TYPE_NATIVE)
+        conversion.dataType = (NDDataType_t)dataType;
+    else
+        conversion.dataType = (NDDataType_t)(outputDataType - 1);
+
+    minX = std::min(std::max(minX, 0), maxSizeX - 1);
+    minY = std::min(std::max(minY, 0), maxSizeY - 1);
+    sizeX = std::min(std::max(sizeX, 1), maxSizeX - minX);
+    sizeY = std::min(std::max(sizeY, 1), maxSizeY - minY);
+    binX = std::min(std::max(binX, 1), sizeX);
+    binY = std::min(std::max(binY, 1), sizeY);
+    setIntegerParam(ADMinX, minX);
+    setIntegerParam(ADMinY, minY);
+    setIntegerParam(ADSizeX, sizeX);
+    setIntegerParam(ADSizeY, sizeY);
+    setIntegerParam(ADBinX, binX);
+    setIntegerParam(ADBinY, binY);
+
+    ADScanPBGeometry_t &geometry = format->geometry;
+    geometry.srcSizeX = maxSizeX;
+    geometry.srcSizeY = maxSizeY;
+    geometry.components = (NDColorMode_t)colorMode == NDColorModeMono ? 1 : 3;
+    geometry.minX = minX;
+    geometry.minY = minY;
+    geometry.sizeX = sizeX - sizeX % binX;
+    geometry.sizeY = sizeY - sizeY % binY;
+    geometry.binX = binX;
+    geometry.binY = binY;
+    geometry.reverseX = reverseX != 0;
+    geometry.reverseY = reverseY != 0;
+    format->transform = !scanPBGeometryIsIdentity(geometry) ||
+                        conversion.dataType != (NDDataType_t)dataType || conversion.scale != 1.0 ||
+                        conversion.offset != 0.0;
+
+    size_t outSizeX = geometry.sizeX / geometry.binX;
+    size_t outSizeY = geometry.sizeY / geometry.binY;
+    if ((NDColorMode_t)colorMode == NDColorModeMono) {
+        format->ndims = 2;
+        format->dims[0] = outSizeX;
+        format->dims[1] = outSizeY;
+    } else {
+        format->ndims = 3;
+        format->dims[0] = 3;
+        format->dims[1] = outSizeX;
+        format->dims[2] = outSizeY;
+    }
+    format->dataType = conversion.dataType;
+    format->srcDataType = (NDDataType_t)dataType;
+    format->colorMode = colorMode;
+    format->frameBytes =
+        outSizeX * outSizeY * geometry.components * scanPBBytesPerElement(conversion.dataType);
+
+    // Frames held in the scan buffer for its entire lifetime can be referenced rather than
+    // copied. Frames in the prefetch ring cannot, since ring slots are reused, and neither can
+    // frames that are cropped, binned, flipped or converted on the way out.
+    format->zeroCopy = zeroCopy == 1 && this->prefetchRing == NULL && !format->transform;
+
+    // Chunks read directly from the scan file can only be emitted as they are stored, while
+    // frames compressed on load are emitted compressed when asked to
+    int emitCompressed;
+    getIntegerParam(ADScanPB_EmitCompressed, &emitCompressed);
+    format->compressed = this->compressedFrames != NULL &&
+                         (this->storeIsPassthrough || emitCompressed == 1);
+    if (format->compressed) {
+        if (format->transform)
+            updateStatus("Region, binning and conversion are not applied to compressed arrays",
+                         ADSCANPB_WARN);
+        format->dataType = (NDDataType_t)dataType;
+        format->transform = false;
+        format->zeroCopy = false;
+        format->frameBytes = this->scan->frameSizeBytes;
+        if ((NDColorMode_t)colorMode == NDColorModeMono) {
+            format->dims[0] = maxSizeX;
+            format->dims[1] = maxSizeY;
+        } else {
+            format->dims[1] = maxSizeX;
+            format->dims[2] = maxSizeY;
+        }
+    }
+}
 
-    updateStatus("Loading scan from URL...", ADSCANPB_LOG);
+/**
+ * @brief Publishes the mean time and throughput of copying frames out of the scan buffer since
+ * the last call, if any frames were copied.
+ */
+void ADScanPB::publishKernelStats() {
+    int kernelFrames = this->kernelFrames.exchange(0);
+    epicsUInt64 kernelTimeNs = this->kernelTimeNs.exchange(0);
+    epicsUInt64 kernelBytes = this->kernelBytes.exchange(0);
+    if (kernelFrames > 0 && kernelTimeNs > 0) {
+        setDoubleParam(ADScanPB_KernelTime, kernelTimeNs / 1000.0 / kernelFrames);
+        setDoubleParam(ADScanPB_KernelGBps, (double)kernelBytes / kernelTimeNs);
+    }
+}
 
-    // First three channels are always the num frames, height, and then width
-    setIntegerParam(ADScanPB_NumFrames, numFrames);
-    setIntegerParam(ADMaxSizeX, xSize);
-    setIntegerParam(ADSizeX, xSize);
-    setIntegerParam(ADMaxSizeY, ySize);
-    setIntegerParam(ADSizeY, ySize);
+/**
+ * @brief Allocates an NDArray for a frame of the scan and fills it, either by copying the frame
+ * out of the scan buffer or prefetch ring, or by referencing it in place for zero-copy playback.
+ * The geometry and data type conversion of the format are applied while copying.
+ *
+ * @param frame Index of the frame in the scan
+ * @param format Layout of the emitted arrays
+ * @return The prepared array, or NULL if allocation failed or playback was stopped
+ */
+NDArray *ADScanPB::prepareFrame(int frame, const ADScanPBFrameFormat_t &format) {
+    if (format.compressed) return prepareCompressedFrame(frame, format);
 
-    size_t numElems = numFrames * ySize * xSize;
-    size_t datasetSizeBytes = numElems * bytesPerElem;
-    size_t datasetSizeMB = datasetSizeBytes / 1000000;
+    NDArray *pArray;
+    size_t dims[3] = {format.dims[0], format.dims[1], format.dims[2]};
 
-    if (bytesPerElem == 1) {
-        setIntegerParam(NDDataType, NDUInt8);
-    } else if (bytesPerElem == 2) {
-        setIntegerParam(NDDataType, NDUInt16);
+    if (format.zeroCopy) {
+        void *frameData =
+            (uint8_t *)this->scan->imageData + (size_t)frame * this->scan->frameSizeBytes;
+        pArray = this->zeroCopyPool->alloc(format.ndims, dims, format.dataType,
+                                           this->scan->frameSizeBytes, frameData);
     } else {
-        updateStatus("Couldn't read image dataset data type!", ADSCANPB_ERR);
-        closeScan();
-        return asynError;
+        pArray = pNDArrayPool->alloc(format.ndims, dims, format.dataType, 0, NULL);
+    }
+    if (pArray == NULL) return NULL;
+
+    if (!format.zeroCopy) {
+        const void *frameData = acquireFrame(frame);
+        if (frameData == NULL) {
+            // Acquisition was stopped while waiting on the prefetch ring
+            pArray->release();
+            return NULL;
+        }
+        epicsUInt64 kernelStart = epicsMonotonicGet();
+        int kernelStatus = 0;
+        if (format.transform)
+            kernelStatus = scanPBTransformFrame(frameData, format.srcDataType, pArray->pData,
+                                                format.geometry, format.conversion);
+        else
+            memcpy(pArray->pData, frameData, this->scan->frameSizeBytes);
+        this->kernelTimeNs += epicsMonotonicGet() - kernelStart;
+        this->kernelBytes += format.frameBytes;
+        this->kernelFrames++;
+        releaseFrame(frame);
+
+        if (kernelStatus != 0) {
+            pArray->release();
+            return NULL;
+        }
     }
 
-    callParamCallbacks();
+    if (format.transform) {
+        // Record the region and transform in the array dimensions, as ADCore does
+        const ADScanPBGeometry_t &geometry = format.geometry;
+        int xDim = format.ndims == 2 ? 0 : 1;
+        pArray->dims[xDim].offset = geometry.minX;
+        pArray->dims[xDim].binning = geometry.binX;
+        pArray->dims[xDim].reverse = geometry.reverseX;
+        pArray->dims[xDim + 1].offset = geometry.minY;
+        pArray->dims[xDim + 1].binning = geometry.binY;
+        pArray->dims[xDim + 1].reverse = geometry.reverseY;
+    }
 
-    // allocate buffer for image data & read entire scan into it.
-    LOG_ARGS("Allocating image buffer of size: %d MB", datasetSizeMB);
-    this->scanImageDataBuffer = calloc(datasetSizeBytes, 1);
+    int colorMode = format.colorMode;
+    pArray->pAttributeList->add("ColorMode", "Color Mode", NDAttrInt32, &colorMode);
+    addSourceFrameAttribute(pArray, frame);
+    return pArray;
+}
 
-    int framesLoaded = 0;
+/**
+ * @brief Records the index of a frame in the source scan on the array, for scans loaded with a
+ * frame selection
+ *
+ * @param pArray Array holding the frame
+ * @param frame Index of the frame in the scan buffer
+ */
+void ADScanPB::addSourceFrameAttribute(NDArray *pArray, int frame) {
+    int sourceFrame = this->scan->sourceFirstFrame + frame * this->scan->sourceFrameStride;
+    pArray->pAttributeList->add("SourceFrame", "Frame index in the source scan", NDAttrInt32,
+                                &sourceFrame);
+}
 
-    int firstDimChunkSize = chunks[0].size();
+/**
+ * @brief Starts the pipeline thread, which keeps up to depth prepared frames queued ahead of
+ * the playback thread, so that at each frame deadline only timestamping and callbacks remain.
+ *
+ * @param depth Maximum number of prepared frames to queue
+ * @param format Layout of the emitted arrays
+ * @param startFrame Frame the playback thread will request first
+ * @param numFrames Number of frames in the scan, the pipeline wraps around at the end
+ */
+void ADScanPB::startPipeline(int depth, const ADScanPBFrameFormat_t &format, int startFrame,
+                             int numFrames) {
+    this->pipelineQueue = epicsMessageQueueCreate(depth, sizeof(ADScanPBPipelineItem_t));
+    this->pipelineFormat = format;
+    this->pipelineNumFrames = numFrames;
+    this->pipelineNextFrame = startFrame;
+    this->pipelineGeneration = 0;
+    this->pipelineStalls = 0;
+    this->pipelineRunning = true;
+
+    epicsThreadOpts opts = EPICS_THREAD_OPTS_INIT;
+    opts.priority = epicsThreadPriorityHigh;
+    opts.stackSize = epicsThreadGetStackSize(epicsThreadStackBig);
+    opts.joinable = 1;
+    this->pipelineThreadId =
+        epicsThreadCreateOpt("pipelineThread", (EPICSTHREADFUNC)pipelineThreadC, this, &opts);
+}
 
-    //int secondChunkListLen = chunks[1].size();
-    size_t bufferWriteOffset = 0;
-    for (int i = 0; i < firstDimChunkSize; i+=1) {
-        //for (int j = 0; j < secondChunkListLen; j++) {
-            //int numAcquisitionsPerChunk = chunks[0][i].get<int>();
-        int numFramesPerChunk = chunks[0][i].get<int>();
-        
+/**
+ * @brief Stops the pipeline thread if it is running, and releases any frames left in the queue
+ */
+void ADScanPB::stopPipeline() {
+    if (this->pipelineQueue == NULL) return;
+
+    this->pipelineRunning = false;
+
+    // Drain the queue before joining, so that a pipeline thread blocked on a full queue can
+    // finish its send and exit straight away. It queues at most one more frame on its way out.
+    ADScanPBPipelineItem_t item;
+    while (epicsMessageQueueTryReceive(this->pipelineQueue, &item, sizeof(item)) >= 0)
+        item.pArray->release();
+    epicsThreadMustJoin(this->pipelineThreadId);
+    while (epicsMessageQueueTryReceive(this->pipelineQueue, &item, sizeof(item)) >= 0)
+        item.pArray->release();
+    epicsMessageQueueDestroy(this->pipelineQueue);
+    this->pipelineQueue = NULL;
+    setIntegerParam(ADScanPB_PipelineOccupancy, 0);
+}
 
-        cpr::Header dataHeader;
-        if (this->tiledApiKey == NULL) {
-            dataHeader = cpr::Header{{string("Accept"), string("application/octet-stream")}};
-        } else {
-            dataHeader = cpr::Header{{string("Authorization"), "Apikey " + string(this->tiledApiKey)},
-                                     {string("Accept"), string("application/octet-stream")}};
+/**
+ * @brief Pipeline thread body. Prepares consecutive frames from the current pipeline position,
+ * and queues them for the playback thread. When playback moves to a different position, the
+ * playback thread bumps the generation and the pipeline restarts from there.
+ */
+void ADScanPB::pipelineThread() {
+    int failedFrame = -1;
+    while (this->pipelineRunning) {
+        epicsMutexLock(this->prefetchMutex);
+        int generation = this->pipelineGeneration;
+        int frame = this->pipelineNextFrame;
+        epicsMutexUnlock(this->prefetchMutex);
+
+        // Don't run ahead of a scan that is still loading
+        if (this->loading && frame >= this->loadedFrontier) {
+            epicsEventWaitWithTimeout(this->loadProgressEventId, 0.1);
+            continue;
+        }
+
+        NDArray *pArray = prepareFrame(frame, this->pipelineFormat);
+        if (pArray == NULL) {
+            // Pool exhausted, wait for downstream to release some arrays. Each frame is only
+            // counted as a failure once, however many retries it takes.
+            if (frame != failedFrame) this->allocFailures++;
+            failedFrame = frame;
+            epicsThreadSleep(0.001);
+            continue;
+        }
+        failedFrame = -1;
+
+        ADScanPBPipelineItem_t item = {pArray, frame, generation};
+        bool queued = false;
+        while (this->pipelineRunning && generation == this->pipelineGeneration) {
+            if (epicsMessageQueueSendWithTimeout(this->pipelineQueue, &item, sizeof(item), 0.1) ==
+                0) {
+                queued = true;
+                break;
+            }
         }
+        if (!queued) pArray->release();
 
-        // TODO - Update to use block url read from metadata above
+        epicsMutexLock(this->prefetchMutex);
+        if (generation == this->pipelineGeneration)
+            this->pipelineNextFrame = (frame + 1) % this->pipelineNumFrames;
+        epicsMutexUnlock(this->prefetchMutex);
+    }
+}
 
-        char fullURLC[512];
-        sprintf(fullURLC, "%s?block=%d,0,0", dataURL.c_str(), i);
+/**
+ * @brief Takes the prepared array for a frame from the pipeline. Frames prepared for a stale
+ * position are discarded, and the pipeline is restarted from the requested frame.
+ *
+ * @param frame Index of the frame to emit
+ * @return The prepared array, or NULL if playback was stopped while waiting
+ */
+NDArray *ADScanPB::receivePipelineFrame(int frame) {
+    ADScanPBPipelineItem_t item;
+    bool stalled = false;
+
+    while (this->playback) {
+        if (epicsMessageQueueTryReceive(this->pipelineQueue, &item, sizeof(item)) < 0) {
+            if (!stalled) {
+                stalled = true;
+                this->pipelineStalls++;
+            }
+            if (epicsMessageQueueReceiveWithTimeout(this->pipelineQueue, &item, sizeof(item),
+                                                    0.1) < 0)
+                continue;
+        }
 
-        string fullURL = string(fullURLC);
+        epicsMutexLock(this->prefetchMutex);
+        bool current = item.generation == this->pipelineGeneration;
+        if (current && item.frame == frame) {
+            epicsMutexUnlock(this->prefetchMutex);
+            return item.pArray;
+        } else if (current) {
+            // Playback position was moved, restart the pipeline from the new position
+            this->pipelineGeneration++;
+            this->pipelineNextFrame = frame;
+        }
+        epicsMutexUnlock(this->prefetchMutex);
+        item.pArray->release();
+    }
+    return NULL;
+}
 
-        LOG_ARGS("%s", fullURL.c_str());
-        size_t numBytesToCopy = numFramesPerChunk * xSize * ySize * bytesPerElem;
+//-------------------------------------------------------------------------
+// ADScanPB Streaming Playback Functions
+//-------------------------------------------------------------------------
 
-        char loadingMsg[256];
-        printf("Dataset of %d %d x %d images, %lu pixels, %lu bytes per image, with %d bytes per pixel.\n\n", numFrames, xSize, ySize, size_t(xSize) * size_t(ySize) * size_t(numFrames), xSize * ySize * bytesPerElem, bytesPerElem);
-        printf("Buffer: %lu, offset %lu\n\n", datasetSizeBytes, bufferWriteOffset);
-        sprintf(loadingMsg, "Loading chunk %d of %d...", i, firstDimChunkSize);
-        // sprintf(loadingMsg, "Loading chunk %d of %d...", (i * secondChunkListLen + j),
-        //         (firstDimChunkSize * secondChunkListLen));
-        updateStatus(loadingMsg, ADSCANPB_LOG);
-        callParamCallbacks();
+/**
+ * @brief Reads a single frame from the open streaming dataset with a hyperslab selection
+ *
+ * @param frame Index of the frame to read, among the frames selected when the scan was loaded
+ * @param dest Buffer of at least frameSizeBytes bytes to read the frame into
+ * @return asynError if the HDF5 read fails, asynSuccess otherwise
+ */
+asynStatus ADScanPB::readFrameHDF5(int frame, void *dest) {
+    std::lock_guard<std::mutex> guard(this->h5Mutex);
+    hid_t fspace = H5Dget_space(this->streamDatasetId);
+    const int ndims = H5Sget_simple_extent_ndims(fspace);
+    hsize_t start[ndims], count[ndims];
+    H5Sget_simple_extent_dims(fspace, count, NULL);
+    for (int i = 0; i < ndims; i++) start[i] = 0;
+    start[0] = this->scan->sourceFirstFrame + (hsize_t)frame * this->scan->sourceFrameStride;
+    count[0] = 1;
+
+    H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, NULL, count, NULL);
+    hid_t mspace = H5Screate_simple(ndims, count, NULL);
+    herr_t err = H5Dread(this->streamDatasetId, this->streamDtypeId, mspace, fspace, H5P_DEFAULT,
+                         dest);
+    H5Sclose(mspace);
+    H5Sclose(fspace);
+
+    if (err < 0) return asynError;
+    return asynSuccess;
+}
 
-        cpr::Response data = cpr::Get(cpr::Url{fullURL}, cpr::ReserveSize{numBytesToCopy * 2},
-                                      cpr::AcceptEncoding({{}}), dataHeader);
+/**
+ * @brief Finds the block of a streamed Tiled scan that holds a frame
+ *
+ * @param frame Index of the frame, among the frames selected when the scan was loaded
+ * @return Index of the block in the source array
+ */
+int ADScanPB::getTiledBlock(int frame) {
+    size_t sourceFrame =
+        this->scan->sourceFirstFrame + (size_t)frame * this->scan->sourceFrameStride;
+    return (int)(std::upper_bound(this->tiledBlockStarts.begin(), this->tiledBlockStarts.end(),
+                                  sourceFrame) -
+                 this->tiledBlockStarts.begin()) - 1;
+}
 
-        if (data.status_code != 200) {
-            updateStatus(data.text.c_str(), ADSCANPB_ERR);
-            free(this->scanImageDataBuffer);
-            return asynError;
-        }
+/**
+ * @brief Gets the number of frames held by a block of a streamed Tiled scan. Blocks fetched with
+ * slice queries only hold the selected frames, other blocks hold every frame they span.
+ *
+ * @param block Index of the block in the source array
+ * @return Number of frames in the block
+ */
+size_t ADScanPB::getTiledBlockFrames(int block) {
+    size_t frames = this->tiledBlockStarts[block + 1] - this->tiledBlockStarts[block];
+    if (this->tiledStreamSlice.empty()) return frames;
+    size_t stride = this->scan->sourceFrameStride;
+    return (frames + stride - 1) / stride;
+}
 
-        cout << data.status_code << endl;
-        cout << data.downloaded_bytes << endl;
-        cout << data.raw_header << endl;
+/**
+ * @brief Gets the first frame past the end of a block of a streamed Tiled scan
+ *
+ * @param block Index of the block in the source array
+ * @param numFrames Number of frames selected when the scan was loaded
+ * @return Index of the first selected frame that follows the block, at most numFrames
+ */
+static int tiledBlockEndFrame(const std::vector<size_t> &blockStarts, int block,
+                              const ADScanPBScanBuffer_t *scan, int numFrames) {
+    size_t first = scan->sourceFirstFrame, stride = scan->sourceFrameStride;
+    size_t end = (blockStarts[block + 1] - first + stride - 1) / stride;
+    return (int)std::min(end, (size_t)numFrames);
+}
 
-        if (data.downloaded_bytes != numBytesToCopy) {
-            char mismatchSizeError[512];
-            snprintf(mismatchSizeError, sizeof(mismatchSizeError), "Recv %lu bytes for chunk %d, expected %lu!", data.downloaded_bytes, i, numBytesToCopy);
-            updateStatus(mismatchSizeError, ADSCANPB_ERR);
-            free(this->scanImageDataBuffer);
-            return asynError;
+/**
+ * @brief Downloads a block of a streamed Tiled scan into the block cache, evicting the least
+ * recently used blocks to keep the cache within its size limit. For arrays chunked along Y and X
+ * too, the tiles of the block are fetched in parallel and copied into place in its frames. The
+ * caller must have claimed the block by adding a block that is not ready to the cache, and must
+ * not hold tiledStreamMutex.
+ *
+ * @param block Index of the block in the source array
+ * @return asynError if the block could not be fetched, in which case it is removed from the
+ * cache, asynSuccess otherwise
+ */
+asynStatus ADScanPB::fetchTiledStreamBlock(int block) {
+    const char *functionName = "fetchTiledStreamBlock";
+
+    size_t frameBytes = this->scan->frameSizeBytes;
+    size_t blockFrames = getTiledBlockFrames(block);
+    size_t numBytes = blockFrames * frameBytes;
+    std::vector<uint8_t> data(numBytes);
+
+    // Up to TiledConcurrency workers fetch tiles, so the latency of a block is not multiplied by
+    // its number of tiles. Arrays chunked by frame only have a single tile per block.
+    size_t elemBytes = this->tiledStreamBytesPerElem;
+    size_t colTiles = this->tiledColStarts.size() - 1;
+    size_t numTiles = (this->tiledRowStarts.size() - 1) * colTiles;
+    size_t width = this->tiledColStarts.back();
+    bool tiled = numTiles > 1;
+
+    std::atomic<size_t> nextTile(0);
+    std::atomic<bool> failed(false);
+    std::mutex errorMutex;
+    string error;
+
+    auto tileWorker = [&]() {
+        std::vector<uint8_t> tile;
+        cpr::Session *session = acquireTiledSession();
+        while (!failed) {
+            size_t t = nextTile++;
+            if (t >= numTiles) break;
+            size_t row = t / colTiles, col = t % colTiles;
+            size_t rows = this->tiledRowStarts[row + 1] - this->tiledRowStarts[row];
+            size_t cols = this->tiledColStarts[col + 1] - this->tiledColStarts[col];
+            size_t tileFrameBytes = rows * cols * elemBytes;
+            if (tiled) tile.resize(blockFrames * tileFrameBytes);
+
+            char url[512];
+            if (this->tiledStreamSlice.empty())
+                snprintf(url, sizeof(url), "%s?block=%d,%lu,%lu", this->tiledStreamURL.c_str(),
+                         block, (unsigned long)row, (unsigned long)col);
+            else
+                snprintf(url, sizeof(url), "%s?slice=%lu:%lu:%d%s", this->tiledStreamURL.c_str(),
+                         (unsigned long)this->tiledBlockStarts[block],
+                         (unsigned long)this->tiledBlockStarts[block + 1],
+                         this->scan->sourceFrameStride, this->tiledStreamSlice.c_str());
+            string tileError;
+            if (downloadTiledBlock(session, string(url), this->tiledStreamHeader,
+                                   this->tiledStreamEncoding, tiled ? tile.data() : data.data(),
+                                   blockFrames * tileFrameBytes, this->tiledStreamStop,
+                                   tileError) != asynSuccess) {
+                std::lock_guard<std::mutex> guard(errorMutex);
+                if (!failed) error = tileError;
+                failed = true;
+                break;
+            }
+            if (!tiled) continue;
+
+            if (this->tiledStreamByteSwap)
+                scanPBByteSwap(tile.data(), tile.size() / elemBytes, elemBytes);
+            for (size_t f = 0; f < blockFrames; f++)
+                scanPBCopyTile(tile.data() + f * tileFrameBytes, data.data() + f * frameBytes,
+                               rows, cols, this->tiledRowStarts[row], this->tiledColStarts[col],
+                               width, elemBytes);
         }
-
-        memcpy((void *)((uint8_t *)this->scanImageDataBuffer + bufferWriteOffset),
-               (void *)data.text.c_str(), numBytesToCopy);
-        framesLoaded = framesLoaded + numFramesPerChunk;
-//        framesLoaded = framesLoaded + (numAcquisitionsPerChunk * numFramesPerChunk);
-        setIntegerParam(ADScanPB_NumFramesLoaded, framesLoaded);
-        setDoubleParam(ADScanPB_LoadPercent, 100 * (framesLoaded / numFrames));
-        callParamCallbacks();
-        bufferWriteOffset += numBytesToCopy;
-        //}
+        releaseTiledSession(session);
+    };
+
+    vector<std::future<void>> workers;
+    size_t numWorkers = std::min(numTiles, (size_t)std::max(this->tiledStreamConcurrency, 1));
+    for (size_t i = 1; i < numWorkers; i++)
+        workers.push_back(std::async(std::launch::async, tileWorker));
+    tileWorker();
+    for (size_t i = 0; i < workers.size(); i++) workers[i].wait();
+
+    asynStatus status = failed ? asynError : asynSuccess;
+    if (status == asynSuccess && !tiled && this->tiledStreamByteSwap)
+        scanPBByteSwap(data.data(), numBytes / elemBytes, elemBytes);
+
+    epicsMutexLock(this->tiledStreamMutex);
+    ADScanPBTiledBlock_t *entry = this->tiledBlocks[block];
+    if (status != asynSuccess) {
+        this->tiledBlocks[block] = NULL;
+        delete entry;
+    } else {
+        // Blocks still being fetched are not counted, and can't be evicted
+        while (this->tiledCacheBytes > 0 &&
+               this->tiledCacheBytes + numBytes > this->tiledCacheMaxBytes) {
+            int lru = -1;
+            for (size_t i = 0; i < this->tiledBlocks.size(); i++) {
+                ADScanPBTiledBlock_t *candidate = this->tiledBlocks[i];
+                if (candidate != NULL && candidate->ready &&
+                    (lru < 0 || candidate->lastUsed < this->tiledBlocks[lru]->lastUsed))
+                    lru = (int)i;
+            }
+            if (lru < 0) break;
+            this->tiledCacheBytes -= this->tiledBlocks[lru]->data.size();
+            delete this->tiledBlocks[lru];
+            this->tiledBlocks[lru] = NULL;
+        }
+        entry->data.swap(data);
+        entry->ready = true;
+        entry->lastUsed = ++this->tiledUseCounter;
+        this->tiledCacheBytes += numBytes;
     }
+    epicsMutexUnlock(this->tiledStreamMutex);
+    epicsEventSignal(this->tiledBlockReadyEventId);
 
-    updateStatus("Done", ADSCANPB_LOG);
-    setIntegerParam(ADScanPB_ScanLoaded, 1);
-    callParamCallbacks();
+    if (status != asynSuccess && !this->tiledStreamStop)
+        ERR_ARGS("Failed to fetch block %d: %s", block, error.c_str());
     return status;
 }
 
+/**
+ * @brief Reads a single frame of a streamed Tiled scan from the block cache, fetching the block
+ * that holds it first if it is not cached. If another reader is already fetching the block, waits
+ * for it rather than fetching it twice.
+ *
+ * @param frame Index of the frame to read, among the frames selected when the scan was loaded
+ * @param dest Buffer of at least frameSizeBytes bytes to read the frame into
+ * @return asynError if the block could not be fetched, asynSuccess otherwise
+ */
+asynStatus ADScanPB::readFrameTiled(int frame, void *dest) {
+    int block = getTiledBlock(frame);
+    size_t sourceFrame =
+        this->scan->sourceFirstFrame + (size_t)frame * this->scan->sourceFrameStride;
+    size_t index = sourceFrame - this->tiledBlockStarts[block];
+    if (!this->tiledStreamSlice.empty()) index /= this->scan->sourceFrameStride;
+    size_t offset = index * this->scan->frameSizeBytes;
+    bool hit = true;
+
+    epicsMutexLock(this->tiledStreamMutex);
+    while (!this->tiledStreamStop) {
+        ADScanPBTiledBlock_t *entry = this->tiledBlocks[block];
+        if (entry != NULL && entry->ready) {
+            memcpy(dest, entry->data.data() + offset, this->scan->frameSizeBytes);
+            entry->lastUsed = ++this->tiledUseCounter;
+            if (hit)
+                this->tiledCacheHits++;
+            else
+                this->tiledCacheMisses++;
+            epicsMutexUnlock(this->tiledStreamMutex);
+            // Pass the wake up on to any other reader waiting on a block
+            if (!hit) epicsEventSignal(this->tiledBlockReadyEventId);
+            return asynSuccess;
+        }
 
-asynStatus ADScanPB::openScanHDF5(const char *fileName) {
-    const char *functionName = "openScanHDF5";
-    asynStatus status = asynSuccess;
-
-    hid_t fileId, imageDatasetId, tsDatasetId;
+        hit = false;
+        if (entry == NULL) {
+            entry = new ADScanPBTiledBlock_t();
+            entry->ready = false;
+            entry->lastUsed = 0;
+            this->tiledBlocks[block] = entry;
+            epicsMutexUnlock(this->tiledStreamMutex);
+            if (fetchTiledStreamBlock(block) != asynSuccess) return asynError;
+        } else {
+            epicsMutexUnlock(this->tiledStreamMutex);
+            epicsEventWaitWithTimeout(this->tiledBlockReadyEventId, 0.01);
+        }
+        epicsMutexLock(this->tiledStreamMutex);
+    }
+    epicsMutexUnlock(this->tiledStreamMutex);
+    return asynError;
+}
 
-    char directoryPath[256], fullFilePath[512];
-    getStringParam(ADScanPB_ExternalPath, 256, (char *)directoryPath);
+/**
+ * @brief Fetches the first block missing from the read-ahead window of a streamed Tiled scan. The
+ * window covers TiledPrefetchTime seconds of playback at the current rate, and at least the
+ * prefetch ring, but no more than fits in the block cache. Blocks in the window count as used, so
+ * that eviction drops the blocks playback has moved past before those it is about to reach. One
+ * reader is always left to copy cached frames into the ring, unless there is only one.
+ *
+ * @param target Next frame the playback thread will request
+ * @return true if a block was fetched, false if the window is already cached or the fetch failed
+ */
+bool ADScanPB::prefetchTiledBlock(int target) {
+    int nframes = this->streamNumFrames;
+    int leadFrames = (int)(this->tiledPrefetchTime * this->streamRateFPS);
+    if (leadFrames < this->prefetchRingDepth) leadFrames = this->prefetchRingDepth;
+    if (leadFrames > nframes) leadFrames = nframes;
+
+    int maxReadAheads = std::max((int)this->prefetchThreadIds.size() - 1, 1);
+
+    epicsMutexLock(this->tiledStreamMutex);
+    if (this->tiledReadAheads >= maxReadAheads) {
+        epicsMutexUnlock(this->tiledStreamMutex);
+        return false;
+    }
+    size_t windowBytes = 0;
+    int lead = 0;
+    while (lead < leadFrames) {
+        int frame = (target + lead) % nframes;
+        int block = getTiledBlock(frame);
+        windowBytes += getTiledBlockFrames(block) * this->scan->frameSizeBytes;
+        if (windowBytes > this->tiledCacheMaxBytes) break;
+
+        ADScanPBTiledBlock_t *entry = this->tiledBlocks[block];
+        if (entry == NULL) {
+            entry = new ADScanPBTiledBlock_t();
+            entry->ready = false;
+            entry->lastUsed = 0;
+            this->tiledBlocks[block] = entry;
+            this->tiledReadAheads++;
+            epicsMutexUnlock(this->tiledStreamMutex);
+            asynStatus status = fetchTiledStreamBlock(block);
+            epicsMutexLock(this->tiledStreamMutex);
+            this->tiledReadAheads--;
+            epicsMutexUnlock(this->tiledStreamMutex);
+            return status == asynSuccess;
+        }
+        if (entry->ready) entry->lastUsed = ++this->tiledUseCounter;
+        lead += tiledBlockEndFrame(this->tiledBlockStarts, block, this->scan, nframes) - frame;
+    }
+    epicsMutexUnlock(this->tiledStreamMutex);
+    return false;
+}
+
+/**
+ * @brief Publishes the block cache statistics of a streamed Tiled scan: its size, its hit rate
+ * and the number of frames following the playback position that are cached
+ *
+ * @param target Next frame the playback thread will request
+ */
+void ADScanPB::publishTiledStreamStats(int target) {
+    int nframes = this->streamNumFrames;
+
+    epicsMutexLock(this->tiledStreamMutex);
+    int lead = 0;
+    while (lead < nframes) {
+        int frame = (target + lead) % nframes;
+        int block = getTiledBlock(frame);
+        ADScanPBTiledBlock_t *entry = this->tiledBlocks[block];
+        if (entry == NULL || !entry->ready) break;
+        lead += tiledBlockEndFrame(this->tiledBlockStarts, block, this->scan, nframes) - frame;
+    }
+    int reads = this->tiledCacheHits + this->tiledCacheMisses;
+    double hitRate = reads > 0 ? 100.0 * this->tiledCacheHits / reads : 0;
+    size_t cacheBytes = this->tiledCacheBytes;
+    epicsMutexUnlock(this->tiledStreamMutex);
+
+    setIntegerParam(ADScanPB_TiledPrefetchLead, std::min(lead, nframes));
+    setDoubleParam(ADScanPB_TiledCacheHitRate, hitRate);
+    setDoubleParam(ADScanPB_TiledCacheSize, cacheBytes / 1000000.0);
+}
+
+/**
+ * @brief Frees the block cache of a streamed Tiled scan. The prefetch threads must be stopped.
+ */
+void ADScanPB::stopTiledStream() {
+    for (size_t i = 0; i < this->tiledBlocks.size(); i++) delete this->tiledBlocks[i];
+    this->tiledBlocks.clear();
+    this->tiledBlockStarts.clear();
+    this->tiledRowStarts.clear();
+    this->tiledColStarts.clear();
+    this->tiledStreamSlice.clear();
+    this->tiledCacheBytes = 0;
+    this->tiledStreaming = false;
+}
+
+/**
+ * @brief Reads a single frame into the prefetch ring, decompressing it from the compressed store
+ * or reading it from the open streaming dataset or Tiled block cache
+ *
+ * @param frame Index of the frame to read
+ * @param dest Buffer of at least frameSizeBytes bytes to read the frame into
+ * @return asynError if the frame could not be read, asynSuccess otherwise
+ */
+asynStatus ADScanPB::readFrame(int frame, void *dest) {
+    if (this->compressedFrames != NULL) return decompressFrame(frame, dest);
+    if (this->tiledStreaming) return readFrameTiled(frame, dest);
+    return readFrameHDF5(frame, dest);
+}
+
+/**
+ * @brief Background reader that keeps the prefetch ring filled with the frames that follow
+ * the current playback position. Frames outside of the window [target, target + depth) are
+ * evicted as the playback position moves forward. Several readers may run at once, each
+ * claiming a different frame.
+ */
+void ADScanPB::prefetchThread() {
+    const char *functionName = "prefetchThread";
+
+    while (this->prefetching) {
+        epicsMutexLock(this->prefetchMutex);
+        int target = this->prefetchTarget;
+        int depth = this->prefetchRingDepth;
+        int nframes = this->streamNumFrames;
+
+        // Find the first frame in the window that is not already resident in the ring
+        int frameToRead = -1;
+        for (int k = 0; k < depth && frameToRead < 0; k++) {
+            int frame = (target + k) % nframes;
+            // Frames of a compressed scan that is still loading may not be in the store yet
+            if (this->loading && frame >= this->loadedFrontier) break;
+            bool resident = false;
+            for (int i = 0; i < depth; i++) {
+                if (this->prefetchRing[i].frame == frame) {
+                    resident = true;
+                    break;
+                }
+            }
+            if (!resident) frameToRead = frame;
+        }
+
+        // Pick an empty slot, or one holding a frame the playback position has moved past
+        ADScanPBRingSlot_t *slot = NULL;
+        if (frameToRead >= 0) {
+            for (int i = 0; i < depth && slot == NULL; i++) {
+                ADScanPBRingSlot_t *candidate = &this->prefetchRing[i];
+                int distance = (candidate->frame - target + nframes) % nframes;
+                if (candidate->pins == 0 && (candidate->frame < 0 || distance >= depth))
+                    slot = candidate;
+            }
+        }
+
+        if (slot == NULL) {
+            // Ring is full with the frames playback needs next, wait for it to advance. Tiled
+            // streaming readers fetch blocks further ahead in the meantime.
+            epicsMutexUnlock(this->prefetchMutex);
+            if (this->tiledStreaming && prefetchTiledBlock(target)) continue;
+            epicsEventWaitWithTimeout(this->prefetchWakeEventId, 0.1);
+            continue;
+        }
+
+        slot->frame = frameToRead;
+        slot->ready = false;
+        epicsMutexUnlock(this->prefetchMutex);
+
+        asynStatus status = readFrame(frameToRead, slot->data);
+
+        epicsMutexLock(this->prefetchMutex);
+        if (status == asynSuccess) {
+            slot->ready = true;
+        } else {
+            slot->frame = -1;
+            ERR_ARGS("Failed to read frame %d from scan file!", frameToRead);
+        }
+        epicsMutexUnlock(this->prefetchMutex);
+        epicsEventSignal(this->prefetchFrameReadyEventId);
+
+        // Avoid spinning on a persistently failing read
+        if (status != asynSuccess) epicsThreadSleep(0.1);
+    }
+}
+
+/**
+ * @brief Allocates the prefetch ring and starts the background reader threads
+ *
+ * @param depth Number of frames to keep resident ahead of the playback position
+ * @param numThreads Number of reader threads filling the ring
+ * @return asynError if the ring could not be allocated, asynSuccess otherwise
+ */
+asynStatus ADScanPB::startPrefetch(int depth, int numThreads) {
+    const char *functionName = "startPrefetch";
+
+    if (depth < 1) depth = 1;
+    if (depth > this->streamNumFrames) depth = this->streamNumFrames;
+
+    LOG_ARGS("Allocating prefetch ring of %d frames, %lu MB", depth,
+             (depth * this->scan->frameSizeBytes) / 1000000);
+    this->prefetchRingBuffer = calloc(depth, this->scan->frameSizeBytes);
+    if (this->prefetchRingBuffer == NULL) {
+        updateStatus("Failed to allocate prefetch ring!", ADSCANPB_ERR);
+        return asynError;
+    }
+
+    this->prefetchRing = (ADScanPBRingSlot_t *)calloc(depth, sizeof(ADScanPBRingSlot_t));
+    for (int i = 0; i < depth; i++) {
+        this->prefetchRing[i].frame = -1;
+        this->prefetchRing[i].ready = false;
+        this->prefetchRing[i].pins = 0;
+        this->prefetchRing[i].data =
+            (uint8_t *)this->prefetchRingBuffer + i * this->scan->frameSizeBytes;
+    }
+    this->prefetchRingDepth = depth;
+    this->prefetchTarget = 0;
+    this->prefetchStalls = 0;
+    this->prefetching = true;
+
+    if (numThreads < 1) numThreads = 1;
+    epicsThreadOpts opts = EPICS_THREAD_OPTS_INIT;
+    opts.priority = epicsThreadPriorityMedium;
+    opts.stackSize = epicsThreadGetStackSize(epicsThreadStackMedium);
+    opts.joinable = 1;
+    for (int i = 0; i < numThreads; i++)
+        this->prefetchThreadIds.push_back(epicsThreadCreateOpt(
+            "prefetchThread", (EPICSTHREADFUNC)prefetchThreadC, this, &opts));
+
+    return asynSuccess;
+}
+
+/**
+ * @brief Stops the background reader threads and frees the prefetch ring
+ */
+void ADScanPB::stopPrefetch() {
+    if (this->prefetching) {
+        this->prefetching = false;
+        for (size_t i = 0; i < this->prefetchThreadIds.size(); i++) {
+            epicsEventSignal(this->prefetchWakeEventId);
+            epicsThreadMustJoin(this->prefetchThreadIds[i]);
+        }
+        this->prefetchThreadIds.clear();
+    }
+
+    if (this->prefetchRing != NULL) free(this->prefetchRing);
+    this->prefetchRing = NULL;
+    if (this->prefetchRingBuffer != NULL) free(this->prefetchRingBuffer);
+    this->prefetchRingBuffer = NULL;
+    this->prefetchRingDepth = 0;
+
+    setIntegerParam(ADScanPB_PrefetchLevel, 0);
+}
+
+/**
+ * @brief Gets a pointer to the data of a frame for playback. For in-memory scans this points
+ * directly into the scan buffer, for streamed scans it blocks until the frame is resident in the
+ * prefetch ring, and pins the slot until releaseFrame is called.
+ *
+ * @param frame Index of the frame to access
+ * @return Pointer to the frame data, or NULL if acquisition was stopped while waiting
+ */
+const void *ADScanPB::acquireFrame(int frame) {
+    if (this->prefetchRing == NULL)
+        return (uint8_t *)this->scan->imageData + frame * this->scan->frameSizeBytes;
+
+    bool stalled = false;
+    epicsMutexLock(this->prefetchMutex);
+    if (this->prefetchTarget != frame) {
+        // Playback position was moved, re-center the prefetch window
+        this->prefetchTarget = frame;
+        epicsEventSignal(this->prefetchWakeEventId);
+    }
+
+    while (this->playback) {
+        for (int i = 0; i < this->prefetchRingDepth; i++) {
+            ADScanPBRingSlot_t *slot = &this->prefetchRing[i];
+            if (slot->frame == frame && slot->ready) {
+                slot->pins++;
+                epicsMutexUnlock(this->prefetchMutex);
+                return slot->data;
+            }
+        }
+
+        if (!stalled) {
+            stalled = true;
+            this->prefetchStalls++;
+        }
+        epicsMutexUnlock(this->prefetchMutex);
+        epicsEventWaitWithTimeout(this->prefetchFrameReadyEventId, 0.1);
+        epicsMutexLock(this->prefetchMutex);
+    }
+    epicsMutexUnlock(this->prefetchMutex);
+    return NULL;
+}
+
+/**
+ * @brief Releases a frame acquired with acquireFrame, and advances the prefetch window past it
+ *
+ * @param frame Index of the frame to release
+ */
+void ADScanPB::releaseFrame(int frame) {
+    if (this->prefetchRing == NULL) return;
+
+    epicsMutexLock(this->prefetchMutex);
+    for (int i = 0; i < this->prefetchRingDepth; i++) {
+        ADScanPBRingSlot_t *slot = &this->prefetchRing[i];
+        if (slot->frame == frame && slot->pins > 0) {
+            slot->pins--;
+            break;
+        }
+    }
+    this->prefetchTarget = (frame + 1) % this->streamNumFrames;
+    epicsMutexUnlock(this->prefetchMutex);
+    epicsEventSignal(this->prefetchWakeEventId);
+}
+
+//-------------------------------------------------------------------------
+// ADScanPB Compressed Scan Store
+//-------------------------------------------------------------------------
+
+/**
+ * @brief Gets the storage mode to load the next scan with. Compressed storage falls back to
+ * loading into memory when the driver was built without blosc. Preloaded scans are always loaded
+ * into memory, since the streaming reader and compressed store serve the active scan.
+ *
+ * @return The effective ADScanPBStorageMode_t
+ */
+int ADScanPB::getStorageMode() {
+    if (this->loadTarget != this->scan) return ADSCANPB_STORAGE_IN_MEMORY;
+
+    int storageMode;
+    getIntegerParam(ADScanPB_StorageMode, &storageMode);
+#ifndef ADSCANPB_WITH_BLOSC
+    if (storageMode == ADSCANPB_STORAGE_COMPRESSED) {
+        updateStatus("Built without blosc, loading into memory uncompressed", ADSCANPB_WARN);
+        storageMode = ADSCANPB_STORAGE_IN_MEMORY;
+    }
+#endif
+    return storageMode;
+}
+
+/**
+ * @brief Allocates the index of the compressed store for a scan, and latches the codec settings
+ * for the load. Frames are added to the store with compressFrames as they are loaded.
+ *
+ * @param numFrames Number of frames in the scan
+ * @return asynError if the index could not be allocated, asynSuccess otherwise
+ */
+asynStatus ADScanPB::startCompressedStore(int numFrames) {
+    int dataType;
+    getIntegerParam(NDDataType, &dataType);
+    getIntegerParam(ADScanPB_CompressCodec, &this->compressCodec);
+    getIntegerParam(ADScanPB_CompressLevel, &this->compressLevel);
+    this->compressTypeSize = scanPBBytesPerElement((NDDataType_t)dataType);
+
+    this->compressedFrames =
+        (ADScanPBCompressedFrame_t *)calloc(numFrames, sizeof(ADScanPBCompressedFrame_t));
+    if (this->compressedFrames == NULL) {
+        updateStatus("Failed to allocate compressed frame index!", ADSCANPB_ERR);
+        return asynError;
+    }
+    this->compressedBytes = 0;
+    this->streamNumFrames = numFrames;
+#ifdef ADSCANPB_WITH_BLOSC
+    this->storeCodec = {NDCODEC_BLOSC, this->compressLevel, BLOSC_BITSHUFFLE,
+                        this->compressCodec == ADSCANPB_CODEC_ZSTD ? BLOSC_ZSTD : BLOSC_LZ4};
+#endif
+    return asynSuccess;
+}
+
+/**
+ * @brief Compresses consecutive frames into the compressed store. May be called concurrently
+ * for disjoint ranges of frames, without the port locked.
+ *
+ * @param firstFrame Index of the first frame in the scan
+ * @param numFrames Number of frames to compress
+ * @param src Uncompressed frames
+ * @param numThreads Number of threads blosc may use for each frame
+ * @return asynError if a frame could not be compressed, asynSuccess otherwise
+ */
+asynStatus ADScanPB::compressFrames(int firstFrame, int numFrames, const void *src,
+                                    int numThreads) {
+#ifdef ADSCANPB_WITH_BLOSC
+    const char *compressor = this->compressCodec == ADSCANPB_CODEC_ZSTD ? "zstd" : "lz4";
+    size_t maxSize = this->scan->frameSizeBytes + BLOSC_MAX_OVERHEAD;
+
+    for (int i = 0; i < numFrames; i++) {
+        const uint8_t *frameData = (const uint8_t *)src + (size_t)i * this->scan->frameSizeBytes;
+        void *compressed = malloc(maxSize);
+        if (compressed == NULL) return asynError;
+
+        int size = blosc_compress_ctx(this->compressLevel, BLOSC_BITSHUFFLE,
+                                      this->compressTypeSize, this->scan->frameSizeBytes,
+                                      frameData, compressed, maxSize, compressor, 0, numThreads);
+        if (size <= 0) {
+            free(compressed);
+            return asynError;
+        }
+
+        // Give back the worst case allowance, so the store only holds the compressed bytes
+        void *shrunk = realloc(compressed, size);
+        if (shrunk != NULL) compressed = shrunk;
+        this->compressedFrames[firstFrame + i].data = compressed;
+        this->compressedFrames[firstFrame + i].size = size;
+        this->compressedBytes += size;
+    }
+    return asynSuccess;
+#else
+    return asynError;
+#endif
+}
+
+/**
+ * @brief Decompresses a frame from the compressed store. Called by the prefetch readers.
+ *
+ * @param frame Index of the frame to decompress
+ * @param dest Buffer of at least frameSizeBytes bytes to decompress the frame into
+ * @return asynError if the frame is not loaded or is corrupt, asynSuccess otherwise
+ */
+asynStatus ADScanPB::decompressFrame(int frame, void *dest) {
+#ifdef ADSCANPB_WITH_BLOSC
+    const ADScanPBCompressedFrame_t &compressed = this->compressedFrames[frame];
+    if (compressed.data == NULL) return asynError;
+
+    epicsUInt64 start = epicsMonotonicGet();
+    int size = blosc_decompress_ctx(compressed.data, dest, this->scan->frameSizeBytes, 1);
+    this->decompressTimeNs += epicsMonotonicGet() - start;
+    this->decompressFrames++;
+
+    if (size != (int)this->scan->frameSizeBytes) return asynError;
+    return asynSuccess;
+#else
+    return asynError;
+#endif
+}
+
+/**
+ * @brief Frees all frames of the compressed store along with its index
+ */
+void ADScanPB::freeCompressedStore() {
+    if (this->compressedFrames == NULL) return;
+
+    for (int i = 0; i < this->streamNumFrames; i++) free(this->compressedFrames[i].data);
+    free(this->compressedFrames);
+    this->compressedFrames = NULL;
+    this->compressedBytes = 0;
+    this->storeCodec = {NDCODEC_NONE, 0, 0, 0};
+    this->storeIsPassthrough = false;
+    setDoubleParam(ADScanPB_CompressionRatio, 0);
+}
+
+/**
+ * @brief Loads the chunks of an HDF5 image dataset into the compressed store as they are stored
+ * in the file, without decompressing them. Each chunk must hold a single frame.
+ *
+ * @param datasetId Image dataset
+ * @param numFrames Number of frames selected from the dataset
+ * @param ndims Number of dimensions of the dataset
+ * @return asynError if a chunk could not be read or the load was cancelled, asynSuccess otherwise
+ */
+asynStatus ADScanPB::loadChunksHDF5(hid_t datasetId, int numFrames, int ndims) {
+    if (startCompressedStore(numFrames) != asynSuccess) return asynError;
+    this->storeIsPassthrough = true;
+    ADScanPBScanBuffer_t *target = this->loadTarget;
+
+    // Chunks are read in batches with the port unlocked, sized like the batches of a full read
+    int framesPerRead = (int)((64 * 1000000) / target->frameSizeBytes);
+    if (framesPerRead < 1) framesPerRead = 1;
+
+    for (int frame = 0; frame < numFrames; frame += framesPerRead) {
+        if (this->loadCancelRequested) return asynError;
+        int count = std::min(framesPerRead, numFrames - frame);
+
+        int failedFrame = -1;
+        unlock();
+        for (int i = frame; i < frame + count && failedFrame < 0; i++) {
+            // Chunks hold one frame each, so only the chunks of the selected frames are read
+            hsize_t sourceFrame =
+                target->sourceFirstFrame + (hsize_t)i * target->sourceFrameStride;
+            hsize_t offset[4] = {sourceFrame, 0, 0, 0};
+            hsize_t chunkSize = 0;
+            uint32_t filterMask = 0;
+            void *chunk = NULL;
+            bool readOk;
+            {
+                std::lock_guard<std::mutex> guard(this->h5Mutex);
+                if (H5Dget_chunk_storage_size(datasetId, offset, &chunkSize) >= 0 &&
+                    chunkSize > 0)
+                    chunk = malloc(chunkSize);
+                readOk = chunk != NULL &&
+                         H5Dread_chunk(datasetId, H5P_DEFAULT, offset, &filterMask, chunk) >= 0;
+            }
+
+            // A set filter mask means the chunk was stored without being compressed
+            if (!readOk || filterMask != 0) {
+                free(chunk);
+                failedFrame = i;
+                break;
+            }
+            this->compressedFrames[i].data = chunk;
+            this->compressedFrames[i].size = chunkSize;
+            this->compressedBytes += chunkSize;
+        }
+        lock();
+
+        if (failedFrame >= 0) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Failed to read compressed chunk of frame %d!",
+                     failedFrame);
+            updateStatus(msg, ADSCANPB_ERR);
+            return asynError;
+        }
+
+        int framesLoaded = frame + count;
+        advanceLoadedFrontier(framesLoaded);
+        setIntegerParam(ADScanPB_NumFramesLoaded, framesLoaded);
+        setDoubleParam(ADScanPB_LoadPercent, 100.0 * framesLoaded / numFrames);
+        callParamCallbacks();
+    }
+    return asynSuccess;
+}
+
+/**
+ * @brief Allocates an NDArray holding a frame of the compressed store as is, with its codec and
+ * compressed size set so that downstream plugins can decompress it or write it directly.
+ *
+ * @param frame Index of the frame in the scan
+ * @param format Layout of the emitted arrays, the arrays are always of the full frame
+ * @return The prepared array, or NULL if allocation failed
+ */
+NDArray *ADScanPB::prepareCompressedFrame(int frame, const ADScanPBFrameFormat_t &format) {
+    const ADScanPBCompressedFrame_t &compressed = this->compressedFrames[frame];
+    size_t dims[3] = {format.dims[0], format.dims[1], format.dims[2]};
+
+    NDArray *pArray =
+        pNDArrayPool->alloc(format.ndims, dims, format.dataType, compressed.size, NULL);
+    if (pArray == NULL) return NULL;
+
+    epicsUInt64 kernelStart = epicsMonotonicGet();
+    memcpy(pArray->pData, compressed.data, compressed.size);
+    this->kernelTimeNs += epicsMonotonicGet() - kernelStart;
+    this->kernelBytes += compressed.size;
+    this->kernelFrames++;
+
+    pArray->codec.name = codecName[this->storeCodec.codec];
+    pArray->codec.level = this->storeCodec.level;
+    pArray->codec.shuffle = this->storeCodec.shuffle;
+    pArray->codec.compressor = this->storeCodec.compressor;
+    pArray->compressedSize = compressed.size;
+
+    int colorMode = format.colorMode;
+    pArray->pAttributeList->add("ColorMode", "Color Mode", NDAttrInt32, &colorMode);
+    addSourceFrameAttribute(pArray, frame);
+    return pArray;
+}
+
+/**
+ * @brief Publishes the throughput of the decompression readers since the last call. The rate
+ * is what the readers together could sustain if kept busy, which is compared against the frame
+ * rate playback is asking for.
+ *
+ * @param targetFPS Frame rate playback is currently running at or aiming for
+ */
+void ADScanPB::publishDecompressStats(double targetFPS) {
+    int frames = this->decompressFrames.exchange(0);
+    epicsUInt64 timeNs = this->decompressTimeNs.exchange(0);
+    if (frames == 0 || timeNs == 0) return;
+
+    double numThreads = (double)this->prefetchThreadIds.size();
+    double capacityFPS = numThreads * frames * 1.0e9 / timeNs;
+    setDoubleParam(ADScanPB_DecompressFPS, capacityFPS);
+    setDoubleParam(ADScanPB_DecompressGBps, capacityFPS * this->scan->frameSizeBytes / 1.0e9);
+    setIntegerParam(ADScanPB_DecompressKeepingUp, capacityFPS >= targetFPS ? 1 : 0);
+}
+
+//-------------------------------------------------------------------------
+// ADScanPB Zero-Copy Array Pool
+//-------------------------------------------------------------------------
+
+void ADScanPBArrayPool::onAllocateArray(NDArray *pArray) { this->numOutstanding++; }
+
+void ADScanPBArrayPool::onReleaseArray(NDArray *pArray) {
+    if (pArray->referenceCount == 0) {
+        // The data belongs to the scan buffer, make sure the pool never frees or reuses it
+        pArray->pData = NULL;
+        this->numOutstanding--;
+    }
+}
+
+//-------------------------------------------------------------------------
+// ADScanPB Background Scan Loading
+//-------------------------------------------------------------------------
+
+/**
+ * @brief Closes out any loaded or loading scan, and starts loading a new one on the loader
+ * thread, so that the asyn port is not blocked for the duration of the load.
+ *
+ * @param scanID ID of the scan to load, interpreted according to the data source
+ * @return asynSuccess once the loader thread has been started
+ */
+asynStatus ADScanPB::startLoad(const char *scanID) {
+    const char *functionName = "startLoad";
+
+    // Zero-copy arrays still held downstream point into the current scan buffer
+    int outstanding = this->zeroCopyPool->getNumOutstanding();
+    setIntegerParam(ADScanPB_ZeroCopyOutstanding, outstanding);
+    if (outstanding > 0) {
+        ERR_ARGS("%d zero-copy arrays reference the current scan", outstanding);
+        updateStatus("Cannot replace scan while zero-copy arrays are held downstream!",
+                     ADSCANPB_ERR);
+        return asynError;
+    }
+
+    cancelLoad();
+    closeScan();
+
+    LOG_ARGS("Starting background load of scan %s", scanID);
+    this->loadedFrontier = 0;
+    launchLoader(scanID);
+    return asynSuccess;
+}
+
+/**
+ * @brief Starts the loader thread, loading a scan into the load target
+ *
+ * @param scanID ID of the scan to load
+ */
+void ADScanPB::launchLoader(const char *scanID) {
+    epicsSnprintf(this->loadingScanID, sizeof(this->loadingScanID), "%s", scanID);
+    this->loadCancelRequested = false;
+    this->loading = true;
+    setIntegerParam(ADScanPB_LoadState, ADSCANPB_LOAD_LOADING);
+
+    epicsThreadOpts opts = EPICS_THREAD_OPTS_INIT;
+    opts.priority = epicsThreadPriorityMedium;
+    opts.stackSize = epicsThreadGetStackSize(epicsThreadStackBig);
+    opts.joinable = 1;
+    this->loaderThreadActive = true;
+    this->loaderThreadId =
+        epicsThreadCreateOpt("loaderThread", (EPICSTHREADFUNC)loaderThreadC, this, &opts);
+}
+
+/**
+ * @brief Cancels an in progress load if there is one, and joins the loader thread.
+ * Must be called with the port locked, the lock is released while waiting for the loader.
+ */
+void ADScanPB::cancelLoad() {
+    const char *functionName = "cancelLoad";
+
+    if (!this->loaderThreadActive) return;
+
+    // Also aborts a cache file write that may still be running after the load completed
+    if (this->loading) LOG("Cancelling in progress scan load...");
+    this->loadCancelRequested = true;
+
+    // The loader thread needs the port lock to publish its final state
+    unlock();
+    epicsThreadMustJoin(this->loaderThreadId);
+    lock();
+    this->loaderThreadActive = false;
+}
+
+/**
+ * @brief Publishes a new loaded frontier, waking up playback and the prefetch ring if they are
+ * waiting on the loader. Nothing waits on a scan being preloaded.
+ *
+ * @param frontier Number of frames from the start of the scan that are now resident
+ */
+void ADScanPB::advanceLoadedFrontier(int frontier) {
+    if (this->loadTarget != this->scan) return;
+    this->loadedFrontier = frontier;
+    epicsEventSignal(this->loadProgressEventId);
+    epicsEventSignal(this->prefetchWakeEventId);
+}
+
+/**
+ * @brief Loader thread body. Holds the port lock except while the loaders perform I/O.
+ */
+void ADScanPB::loaderThread() {
+    const char *functionName = "loaderThread";
+    asynStatus status = asynError;
+
+    lock();
+    bool preload = this->loadTarget != this->scan;
+    int dataSource, cacheEnable;
+    getIntegerParam(ADScanPB_DataSource, &dataSource);
+    getIntegerParam(ADScanPB_CacheEnable, &cacheEnable);
+
+    // The cache holds decompressed frames, so is bypassed when emitting compressed arrays
+    int emitCompressed;
+    getIntegerParam(ADScanPB_EmitCompressed, &emitCompressed);
+    string cacheKey;
+    if (cacheEnable == 1 && emitCompressed == 0) cacheKey = buildCacheKey(this->loadingScanID);
+
+    int sharedMemory;
+    getIntegerParam(ADScanPB_SharedMemory, &sharedMemory);
+    string sharedKey;
+    if (sharedMemory == 1 && emitCompressed == 0) sharedKey = buildScanKey(this->loadingScanID);
+
+    // The frame selection is part of the scan key, so a scan served from the cache or a shared
+    // segment holds the same frames as one read from the source
+    ADScanPBScanBuffer_t *target = this->loadTarget;
+    getIntegerParam(ADScanPB_FirstFrame, &target->sourceFirstFrame);
+    getIntegerParam(ADScanPB_FrameStride, &target->sourceFrameStride);
+    if (target->sourceFrameStride < 1) target->sourceFrameStride = 1;
+
+    if (!sharedKey.empty() && attachSharedScan(sharedKey, true) == asynSuccess) {
+        status = asynSuccess;
+    } else if (!cacheKey.empty() && openScanCache(cacheKey) == asynSuccess) {
+        int hits;
+        getIntegerParam(ADScanPB_CacheHits, &hits);
+        setIntegerParam(ADScanPB_CacheHits, hits + 1);
+        status = asynSuccess;
+    } else if (dataSource == ADSCANPB_DS_HDF5)
+        status = this->openScanHDF5(this->loadingScanID);
+    else if (dataSource == ADSCANPB_DS_TILED)
+        status = this->openScanTiled(this->loadingScanID);
+    else
+        updateStatus("Selected data source not supported in current ADScanPB build!",
+                     ADSCANPB_ERR);
+
+    this->loading = false;
+    epicsEventSignal(this->loadProgressEventId);
+
+    if (status == asynSuccess) {
+        setIntegerParam(ADScanPB_LoadState, ADSCANPB_LOAD_LOADED);
+
+        // Persist the scan so the next load of it can be served from the local cache
+        if (!cacheKey.empty() && this->loadTarget->mapping == NULL) {
+            int misses;
+            getIntegerParam(ADScanPB_CacheMisses, &misses);
+            setIntegerParam(ADScanPB_CacheMisses, misses + 1);
+            callParamCallbacks();
+            writeScanCache(cacheKey);
+        }
+
+        // Share the scan with other IOCs on this host, unless it already is
+        if (!sharedKey.empty() && this->loadTarget->sharedHeader == NULL)
+            publishSharedScan(sharedKey);
+
+        epicsSnprintf(this->loadTarget->scanID, sizeof(this->loadTarget->scanID), "%s",
+                      this->loadingScanID);
+        if (this->loadTarget->playlistEntry >= 0) this->playlistFailures = 0;
+        if (preload) {
+            epicsMutexLock(this->scanSwapMutex);
+            this->loadTarget = this->scan;
+            this->nextScanReady = true;
+            epicsMutexUnlock(this->scanSwapMutex);
+            setIntegerParam(ADScanPB_NextScanReady, 1);
+            updateStatus("Next scan loaded", ADSCANPB_LOG);
+
+            // A swap requested while playing is made by the playback thread
+            if (this->swapRequested && !this->playback) swapNextScan();
+        }
+    } else if (preload) {
+        // Free anything that was partially loaded, leaving the active scan untouched
+        if (this->loadTarget->playlistEntry >= 0 && !this->loadCancelRequested)
+            this->playlistFailures++;
+        freeScanBuffer(this->loadTarget);
+        this->loadTarget = this->scan;
+        if (this->loadCancelRequested) {
+            updateStatus("Next scan preload cancelled", ADSCANPB_WARN);
+            setIntegerParam(ADScanPB_LoadState, ADSCANPB_LOAD_CANCELLED);
+        } else {
+            setIntegerParam(ADScanPB_LoadState, ADSCANPB_LOAD_FAILED);
+        }
+    } else {
+        // Free anything that was partially loaded
+        if (this->loadTarget->playlistEntry >= 0 && !this->loadCancelRequested)
+            this->playlistFailures++;
+        closeScan();
+        if (this->loadCancelRequested) {
+            updateStatus("Scan load cancelled", ADSCANPB_WARN);
+            setIntegerParam(ADScanPB_LoadState, ADSCANPB_LOAD_CANCELLED);
+        } else {
+            setIntegerParam(ADScanPB_LoadState, ADSCANPB_LOAD_FAILED);
+        }
+    }
+    // The load progress of a preload is only reported while it is in progress
+    if (preload) {
+        setIntegerParam(ADScanPB_NumFramesLoaded, this->scan->numFrames);
+        setDoubleParam(ADScanPB_LoadPercent, 100);
+    }
+    LOG_ARGS("Load of scan %s finished with status %d", this->loadingScanID, status);
+    callParamCallbacks();
+
+    // Move the playlist along, or past an entry that failed to load
+    if (this->playlistActive) epicsEventSignal(this->playlistEventId);
+    unlock();
+}
+
+//-------------------------------------------------------------------------
+// ADScanPB Next Scan Preloading
+//-------------------------------------------------------------------------
+
+/**
+ * @brief Starts loading the next scan in the background, without interrupting playback of the
+ * active scan. Once loaded, it is swapped in by swapNextScan. If no scan is loaded, the scan is
+ * simply loaded as the active scan.
+ *
+ * @param scanID ID of the scan to preload, interpreted according to the data source
+ * @return asynError if the next scan can't be preloaded right now
+ */
+asynStatus ADScanPB::startPreload(const char *scanID) {
+    const char *functionName = "startPreload";
+
+    int scanLoaded, emitCompressed;
+    getIntegerParam(ADScanPB_ScanLoaded, &scanLoaded);
+    getIntegerParam(ADScanPB_EmitCompressed, &emitCompressed);
+    if (scanLoaded != 1 && !this->loading) return startLoad(scanID);
+
+    if (this->loading && this->loadTarget == this->scan) {
+        updateStatus("Cannot preload the next scan while the current scan is loading!",
+                     ADSCANPB_ERR);
+        return asynError;
+    }
+    if (emitCompressed == 1) {
+        updateStatus("Cannot preload the next scan while emitting compressed arrays!",
+                     ADSCANPB_ERR);
+        return asynError;
+    }
+
+    // Replaces a preload that is still in progress
+    cancelLoad();
+
+    // The slot still holds the previous scan if zero-copy arrays referenced it when swapped out
+    epicsMutexLock(this->scanSwapMutex);
+    int outstanding = this->zeroCopyPool->getNumOutstanding();
+    if (this->nextScan->imageData != NULL && !this->nextScanReady && outstanding > 0) {
+        epicsMutexUnlock(this->scanSwapMutex);
+        ERR_ARGS("%d zero-copy arrays reference the previous scan", outstanding);
+        updateStatus("Cannot preload scan while zero-copy arrays are held downstream!",
+                     ADSCANPB_ERR);
+        return asynError;
+    }
+    this->nextScanReady = false;
+    freeScanBuffer(this->nextScan);
+    this->loadTarget = this->nextScan;
+    epicsMutexUnlock(this->scanSwapMutex);
+    setIntegerParam(ADScanPB_NextScanReady, 0);
+
+    LOG_ARGS("Starting background preload of next scan %s", scanID);
+    launchLoader(scanID);
+    return asynSuccess;
+}
+
+/**
+ * @brief Makes the preloaded next scan the active scan. Must not be called while the pipeline is
+ * running. The outgoing scan is freed, unless zero-copy arrays held downstream still reference
+ * it, in which case it stays in the next scan slot until the next preload.
+ *
+ * @return true if the scans were swapped, false if no next scan is ready
+ */
+bool ADScanPB::swapNextScan() {
+    const char *functionName = "swapNextScan";
+
+    epicsMutexLock(this->scanSwapMutex);
+    if (!this->nextScanReady || this->loading) {
+        epicsMutexUnlock(this->scanSwapMutex);
+        return false;
+    }
+
+    // Preloaded scans are always held in memory, so the streaming reader or compressed store
+    // belongs to the outgoing scan
+    releaseScanStorage();
+    bool resized =
+        this->nextScan->sizeX != this->scan->sizeX || this->nextScan->sizeY != this->scan->sizeY;
+    std::swap(this->scan, this->nextScan);
+    this->loadTarget = this->scan;
+    this->nextScanReady = false;
+    this->swapRequested = false;
+    advanceLoadedFrontier(this->scan->numFrames);
+    if (this->zeroCopyPool->getNumOutstanding() == 0) freeScanBuffer(this->nextScan);
+    epicsMutexUnlock(this->scanSwapMutex);
+
+    LOG_ARGS("Swapped in next scan %s", this->scan->scanID);
+    publishScanShape(resized);
+    setStringParam(ADScanPB_ScanID, this->scan->scanID);
+    setIntegerParam(ADScanPB_NextScanReady, 0);
+    setIntegerParam(ADScanPB_ScanLoaded, 1);
+    setIntegerParam(ADScanPB_NumFramesLoaded, this->scan->numFrames);
+    setDoubleParam(ADScanPB_LoadPercent, 100);
+    ADScanPBSharedHeader_t *sharedHeader = this->scan->sharedHeader;
+    setIntegerParam(ADScanPB_SharedAttached,
+                    sharedHeader != NULL && this->scan->mapping != NULL);
+    setIntegerParam(ADScanPB_SharedUsers,
+                    sharedHeader == NULL ? 0 : epicsAtomicGetIntT(&sharedHeader->refCount));
+    if (this->scan->playlistEntry >= 0)
+        setIntegerParam(ADScanPB_PlaylistIndex, this->scan->playlistEntry);
+    updateStatus("Swapped in next scan", ADSCANPB_LOG);
+    callParamCallbacks();
+
+    // Start preloading the entry after this one
+    if (this->playlistActive) epicsEventSignal(this->playlistEventId);
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// ADScanPB Scan Playlist
+//-------------------------------------------------------------------------
+
+/**
+ * @brief Reads a string field of a playlist entry
+ *
+ * @param entry_j Playlist entry
+ * @param key Name of the field
+ * @param fallback Value used if the field is left out
+ * @param value Set to the value of the field
+ * @return false if the field is present but not a string
+ */
+static bool getPlaylistString(const json &entry_j, const char *key, const string &fallback,
+                              string *value) {
+    json::const_iterator field = entry_j.find(key);
+    if (field == entry_j.end()) {
+        *value = fallback;
+        return true;
+    }
+    if (!field->is_string()) return false;
+    *value = field->get<string>();
+    return true;
+}
+
+/**
+ * @brief Reads an integer field of a playlist entry
+ *
+ * @param entry_j Playlist entry
+ * @param key Name of the field
+ * @param fallback Value used if the field is left out
+ * @param value Set to the value of the field
+ * @return false if the field is present but not an integer
+ */
+static bool getPlaylistInt(const json &entry_j, const char *key, int fallback, int *value) {
+    json::const_iterator field = entry_j.find(key);
+    if (field == entry_j.end()) {
+        *value = fallback;
+        return true;
+    }
+    if (!field->is_number_integer()) return false;
+    *value = field->get<int>();
+    return true;
+}
+
+/**
+ * @brief Parses a playlist, a JSON array with an object per scan, and replaces the current
+ * playlist with it. Each entry has a scan_id, and optionally a source ("hdf5" or "tiled"), path,
+ * dataset, ts_dataset, first_frame, last_frame and repeat count. Fields left out take the value
+ * of the matching PV when the playlist is parsed. A running playlist is stopped.
+ *
+ * @param text JSON text of the playlist
+ * @return asynError if the playlist is not valid
+ */
+asynStatus ADScanPB::parsePlaylist(const string &text) {
+    const char *functionName = "parsePlaylist";
+
+    int dataSource;
+    char path[256], imageDataset[256], tsDataset[256];
+    getIntegerParam(ADScanPB_DataSource, &dataSource);
+    getStringParam(ADScanPB_ExternalPath, 256, path);
+    getStringParam(ADScanPB_ImageDataset, 256, imageDataset);
+    getStringParam(ADScanPB_TSDataset, 256, tsDataset);
+
+    // Parse without exceptions, malformed playlists are reported like any other bad input
+    json playlist_j = json::parse(text, nullptr, false);
+    if (playlist_j.is_discarded() || !playlist_j.is_array() || playlist_j.empty()) {
+        updateStatus("Playlist must be a non-empty JSON array!", ADSCANPB_ERR);
+        return asynError;
+    }
+
+    std::vector<ADScanPBPlaylistEntry_t> entries;
+    for (size_t i = 0; i < playlist_j.size(); i++) {
+        const json &entry_j = playlist_j[i];
+        ADScanPBPlaylistEntry_t entry;
+        string source;
+        bool valid = entry_j.is_object() &&
+                     getPlaylistString(entry_j, "source", "", &source) &&
+                     getPlaylistString(entry_j, "path", path, &entry.path) &&
+                     getPlaylistString(entry_j, "scan_id", "", &entry.scanID) &&
+                     getPlaylistString(entry_j, "dataset", imageDataset, &entry.imageDataset) &&
+                     getPlaylistString(entry_j, "ts_dataset", tsDataset, &entry.tsDataset) &&
+                     getPlaylistInt(entry_j, "first_frame", 0, &entry.firstFrame) &&
+                     getPlaylistInt(entry_j, "last_frame", -1, &entry.lastFrame) &&
+                     getPlaylistInt(entry_j, "stride", 1, &entry.frameStride) &&
+                     getPlaylistInt(entry_j, "repeat", 1, &entry.repeat);
+
+        entry.dataSource = dataSource;
+        if (source == "hdf5")
+            entry.dataSource = ADSCANPB_DS_HDF5;
+        else if (source == "tiled")
+            entry.dataSource = ADSCANPB_DS_TILED;
+        else if (!source.empty())
+            valid = false;
+
+        if (!valid || entry.scanID.empty() || entry.firstFrame < 0 || entry.frameStride < 1 ||
+            entry.repeat < 1 || (entry.lastFrame >= 0 && entry.lastFrame < entry.firstFrame)) {
+            ERR_ARGS("Invalid playlist entry %d: %s", (int)i, entry_j.dump().c_str());
+            updateStatus("Invalid playlist entry!", ADSCANPB_ERR);
+            return asynError;
+        }
+        entries.push_back(entry);
+    }
+
+    stopPlaylist();
+    setIntegerParam(ADScanPB_PlaylistEnable, 0);
+    this->playlist = entries;
+    setIntegerParam(ADScanPB_PlaylistLength, (int)entries.size());
+    LOG_ARGS("Parsed playlist of %d scans", (int)entries.size());
+    return asynSuccess;
+}
+
+/**
+ * @brief Reads a playlist from a JSON file
+ *
+ * @param filePath Path to the playlist file
+ * @return asynError if the file can't be read or is not a valid playlist
+ */
+asynStatus ADScanPB::readPlaylistFile(const char *filePath) {
+    std::ifstream file(filePath);
+    if (!file) {
+        updateStatus("Failed to open playlist file!", ADSCANPB_ERR);
+        return asynError;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return parsePlaylist(text.str());
+}
+
+/**
+ * @brief Starts the playlist from its first entry, which is loaded as the active scan. Each
+ * following entry is preloaded while the one before it plays.
+ *
+ * @return asynError if there is no playlist, or it can't be played back
+ */
+asynStatus ADScanPB::startPlaylist() {
+    if (this->playlist.empty()) {
+        updateStatus("No playlist has been set!", ADSCANPB_ERR);
+        return asynError;
+    }
+    int emitCompressed;
+    getIntegerParam(ADScanPB_EmitCompressed, &emitCompressed);
+    if (emitCompressed == 1) {
+        updateStatus("Cannot play a playlist while emitting compressed arrays!", ADSCANPB_ERR);
+        return asynError;
+    }
+    int zeroCopy;
+    getIntegerParam(ADScanPB_ZeroCopy, &zeroCopy);
+    if (zeroCopy == 1) {
+        updateStatus("Cannot play a playlist while zero-copy is enabled!", ADSCANPB_ERR);
+        return asynError;
+    }
+
+    // Wait for any previous load here, while the playlist thread has nothing to act on, since the
+    // port is unlocked while the loader is joined
+    stopPlaylist();
+    cancelLoad();
+
+    this->playlistActive = true;
+    this->playlistFailures = 0;
+    this->playlistUnderruns = 0;
+    setIntegerParam(ADScanPB_PlaylistUnderruns, 0);
+    setIntegerParam(ADScanPB_PlaylistIndex, 0);
+    setIntegerParam(ADScanPB_PlaylistPass, 1);
+    asynStatus status = loadPlaylistEntry(0, false);
+    if (status != asynSuccess) stopPlaylist();
+    return status;
+}
+
+/**
+ * @brief Stops advancing through the playlist, cancelling the preload of the next entry. The
+ * active scan is left loaded, and plays on as any other scan would.
+ */
+void ADScanPB::stopPlaylist() {
+    if (!this->playlistActive) return;
+    this->playlistActive = false;
+    this->playlistNextEntry = -1;
+    if (this->loading && this->loadTarget != this->scan) cancelLoad();
+}
+
+/**
+ * @brief Points the data source PVs at a playlist entry, and starts loading it
+ *
+ * @param index Index of the entry in the playlist
+ * @param preload Whether the entry is preloaded as the next scan, or loaded as the active scan
+ * @return asynError if the load could not be started
+ */
+asynStatus ADScanPB::loadPlaylistEntry(int index, bool preload) {
+    const char *functionName = "loadPlaylistEntry";
+    const ADScanPBPlaylistEntry_t &entry = this->playlist[index];
+
+    setIntegerParam(ADScanPB_DataSource, entry.dataSource);
+    updateFieldDescriptions((ADScanPBDataSource_t)entry.dataSource);
+    setStringParam(ADScanPB_ExternalPath, entry.path);
+    setStringParam(ADScanPB_ImageDataset, entry.imageDataset);
+    setStringParam(ADScanPB_TSDataset, entry.tsDataset);
+    setIntegerParam(ADScanPB_FirstFrame, entry.firstFrame);
+    setIntegerParam(ADScanPB_LastFrame, entry.lastFrame);
+    setIntegerParam(ADScanPB_FrameStride, entry.frameStride);
+    this->playlistCursor = index;
+
+    LOG_ARGS("Loading playlist entry %d, scan %s", index, entry.scanID.c_str());
+    asynStatus status;
+    if (preload) {
+        setStringParam(ADScanPB_NextScanID, entry.scanID);
+        this->playlistNextEntry = index;
+        status = startPreload(entry.scanID.c_str());
+    } else {
+        // Until the entry after it is picked, the entry is repeated in place
+        setStringParam(ADScanPB_ScanID, entry.scanID);
+        this->playlistNextEntry = index;
+        status = startLoad(entry.scanID.c_str());
+    }
+    if (status != asynSuccess) return status;
+
+    // The loader thread waits on the port lock, so the entry is recorded before it starts
+    ADScanPBScanBuffer_t *target = this->loadTarget;
+    target->playlistEntry = index;
+    target->repeat = entry.repeat;
+    return asynSuccess;
+}
+
+/**
+ * @brief Starts loading the next playlist entry once nothing else is loading. Entries that fail
+ * to load are skipped, and the playlist is stopped if none of them can be loaded.
+ */
+void ADScanPB::advancePlaylist() {
+    if (!this->playlistActive) return;
+    if (this->scan->playlistEntry >= 0)
+        setIntegerParam(ADScanPB_PlaylistIndex, this->scan->playlistEntry);
+
+    // The loader wakes this thread up again once it is done
+    if (this->loading || this->nextScanReady) return;
+
+    int numEntries = (int)this->playlist.size();
+    if (this->playlistFailures >= numEntries) {
+        updateStatus("No playlist entry could be loaded, stopping playlist", ADSCANPB_ERR);
+        stopPlaylist();
+        setIntegerParam(ADScanPB_PlaylistEnable, 0);
+        return;
+    }
+
+    int next = this->playlistCursor + 1;
+    if (next >= numEntries) {
+        int loop;
+        getIntegerParam(ADScanPB_PlaylistLoop, &loop);
+        if (loop != 1) {
+            // Playback stops once the last entry has been played
+            this->playlistNextEntry = -1;
+            return;
+        }
+        next = 0;
+    }
+
+    int scanLoaded;
+    getIntegerParam(ADScanPB_ScanLoaded, &scanLoaded);
+    asynStatus status;
+    if (scanLoaded != 1) {
+        // The active entry failed to load, load the next one in its place
+        status = loadPlaylistEntry(next, false);
+    } else if (next == this->scan->playlistEntry) {
+        // Only the active entry is left to play, so it is repeated in place
+        this->playlistNextEntry = next;
+        return;
+    } else {
+        status = loadPlaylistEntry(next, true);
+    }
+
+    if (status != asynSuccess) {
+        updateStatus("Failed to start loading the next playlist entry, stopping playlist",
+                     ADSCANPB_ERR);
+        stopPlaylist();
+        setIntegerParam(ADScanPB_PlaylistEnable, 0);
+    }
+}
+
+/**
+ * @brief Checks whether the active scan is a playlist entry that has been played the requested
+ * number of times, and should be replaced by the next entry.
+ *
+ * @param passes Number of passes made through the active scan
+ * @return true if the next entry should be swapped in
+ */
+bool ADScanPB::playlistEntryDone(int passes) {
+    return this->playlistActive && this->scan->playlistEntry >= 0 &&
+           passes >= this->scan->repeat;
+}
+
+/**
+ * @brief Decides whether playback goes on once a pass through the active scan is complete.
+ * Playlist entries are repeated until they have been played the requested number of times, and
+ * beyond that until the next entry has loaded, so playback only ends after the last entry.
+ * Other scans repeat with AutoRepeat, or go on to the next scan with AutoSwap.
+ *
+ * @param autoRepeat Value of the AutoRepeat PV
+ * @param autoSwap Value of the AutoSwap PV
+ * @param passes Number of passes made through the active scan
+ * @return false if playback should stop
+ */
+bool ADScanPB::continuePlayback(int autoRepeat, int autoSwap, int passes) {
+    if (this->playlistActive && this->scan->playlistEntry >= 0)
+        return passes < this->scan->repeat || this->playlistNextEntry >= 0;
+    return autoRepeat == 1 || (autoSwap == 1 && this->nextScanReady);
+}
+
+/**
+ * @brief Playlist thread body. Moves the playlist along whenever a load finishes or a scan is
+ * swapped in. Runs with the port locked, since starting a load needs it, and so is kept apart
+ * from the playback thread, which only takes the port lock to swap in the next scan.
+ */
+void ADScanPB::playlistThread() {
+    while (true) {
+        epicsEventWait(this->playlistEventId);
+        lock();
+        if (!this->playlistThreadRunning) {
+            unlock();
+            return;
+        }
+        advancePlaylist();
+        callParamCallbacks();
+        unlock();
+    }
+}
+
+//-------------------------------------------------------------------------
+// ADScanPB Local Scan Cache
+//-------------------------------------------------------------------------
+
+/**
+ * @brief Builds the key identifying a scan from the data source, path, scan ID, datasets and
+ * selected frames. For HDF5 files the size and modification time of the file are included, so
+ * that a rewritten file is not served from a stale copy of it.
+ *
+ * @param scanID ID of the scan being loaded
+ * @return Scan key, or an empty string if the scan cannot be identified
+ */
+string ADScanPB::buildScanKey(const char *scanID) {
+    char externalPath[256], imageDataset[256], tsDataset[256];
+    int dataSource;
+    getIntegerParam(ADScanPB_DataSource, &dataSource);
+    getStringParam(ADScanPB_ExternalPath, 256, externalPath);
+    getStringParam(ADScanPB_ImageDataset, 256, imageDataset);
+    getStringParam(ADScanPB_TSDataset, 256, tsDataset);
+
+    char source[512];
+    if (dataSource == ADSCANPB_DS_HDF5) {
+        char fullFilePath[512];
+        struct stat st;
+        snprintf(fullFilePath, sizeof(fullFilePath), "%s/%s", externalPath, scanID);
+        if (stat(fullFilePath, &st) != 0) return string();
+        snprintf(source, sizeof(source), "hdf5:%lld:%lld", (long long)st.st_size,
+                 (long long)st.st_mtime);
+    } else if (dataSource == ADSCANPB_DS_TILED) {
+        char serverURL[256];
+        getStringParam(ADScanPB_TiledServerURL, 256, serverURL);
+        int minX, minY, sizeX, sizeY;
+        getIntegerParam(ADScanPB_TiledMinX, &minX);
+        getIntegerParam(ADScanPB_TiledMinY, &minY);
+        getIntegerParam(ADScanPB_TiledSizeX, &sizeX);
+        getIntegerParam(ADScanPB_TiledSizeY, &sizeY);
+        snprintf(source, sizeof(source), "tiled:%s:%d,%d,%d,%d", serverURL, minX, minY, sizeX,
+                 sizeY);
+    } else {
+        return string();
+    }
+
+    int firstFrame, lastFrame, frameStride;
+    getIntegerParam(ADScanPB_FirstFrame, &firstFrame);
+    getIntegerParam(ADScanPB_LastFrame, &lastFrame);
+    getIntegerParam(ADScanPB_FrameStride, &frameStride);
+    char selection[64];
+    snprintf(selection, sizeof(selection), "%d:%d:%d", firstFrame, lastFrame,
+             std::max(frameStride, 1));
+
+    return string(source) + "|" + externalPath + "|" + scanID + "|" + imageDataset + "|" +
+           tsDataset + "|" + selection;
+}
+
+/**
+ * @brief Builds the key identifying a scan in the local cache
+ *
+ * @param scanID ID of the scan being loaded
+ * @return Cache key, or an empty string if the scan cannot be cached
+ */
+string ADScanPB::buildCacheKey(const char *scanID) {
+    char cacheDir[256];
+    getStringParam(ADScanPB_CacheDir, 256, cacheDir);
+    if (strlen(cacheDir) == 0) return string();
+    return buildScanKey(scanID);
+}
+
+/**
+ * @brief Hashes a scan key with 64 bit FNV-1a, to name the cache file or shared memory segment
+ * holding the scan
+ */
+static uint64_t hashScanKey(const string &key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Maps a cache key to the path of its cache file, using the hash of the key
+ *
+ * @param key Cache key built by buildCacheKey
+ * @return Path to the cache file
+ */
+string ADScanPB::getCacheFilePath(const string &key) {
+    char cacheDir[256], path[512];
+    getStringParam(ADScanPB_CacheDir, 256, cacheDir);
+    snprintf(path, sizeof(path), "%s/%016llx.scanpb", cacheDir,
+             (unsigned long long)hashScanKey(key));
+    return string(path);
+}
+
+/**
+ * @brief Describes the scan just loaded in a cache header, laying out the image data and
+ * timestamps on page boundaries after a header of the given size
+ *
+ * @param header Header to fill
+ * @param key Key of the scan
+ * @param headerSize Size of the header the scan data follows
+ */
+void ADScanPB::fillCacheHeader(ADScanPBCacheHeader_t *header, const string &key,
+                               size_t headerSize) {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, ADSCANPB_CACHE_MAGIC, sizeof(header->magic));
+    header->version = ADSCANPB_CACHE_VERSION;
+    const ADScanPBScanBuffer_t *buffer = this->loadTarget;
+    header->numFrames = buffer->numFrames;
+    header->sizeX = buffer->sizeX;
+    header->sizeY = buffer->sizeY;
+    header->dataType = buffer->dataType;
+    header->colorMode = buffer->colorMode;
+    header->numTimestamps = buffer->timestampData == NULL ? 0 : buffer->numTimestamps;
+    header->frameSizeBytes = buffer->frameSizeBytes;
+    strncpy(header->key, key.c_str(), sizeof(header->key) - 1);
+
+    size_t dataBytes = (size_t)header->numFrames * header->frameSizeBytes;
+    header->dataOffset = ((headerSize + pageSize - 1) / pageSize) * pageSize;
+    header->tsOffset = header->dataOffset + ((dataBytes + pageSize - 1) / pageSize) * pageSize;
+}
+
+/**
+ * @brief Attempts to open a scan from the local cache, mapping the cache file into memory in
+ * place of reading the scan into a heap buffer.
+ *
+ * @param key Cache key of the scan
+ * @return asynSuccess on a cache hit, asynError if the scan is not cached
+ */
+asynStatus ADScanPB::openScanCache(const string &key) {
+    const char *functionName = "openScanCache";
+
+    string path = getCacheFilePath(key);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return asynError;
+
+    ADScanPBCacheHeader_t header;
+    struct stat st;
+    bool valid = fstat(fd, &st) == 0 &&
+                 pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                 memcmp(header.magic, ADSCANPB_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == ADSCANPB_CACHE_VERSION &&
+                 strncmp(header.key, key.c_str(), sizeof(header.key)) == 0;
+    if (valid) {
+        size_t dataEnd = header.dataOffset + (size_t)header.numFrames * header.frameSizeBytes;
+        size_t tsEnd = header.tsOffset + (size_t)header.numTimestamps * sizeof(double);
+        valid = (size_t)st.st_size >= dataEnd && (size_t)st.st_size >= tsEnd;
+    }
+    if (!valid) {
+        WARN_ARGS("Ignoring invalid cache file %s", path.c_str());
+        close(fd);
+        return asynError;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        WARN_ARGS("Failed to map cache file %s", path.c_str());
+        return asynError;
+    }
+    posix_madvise(mapping, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    // Touch the file so that eviction treats it as most recently used
+    utimes(path.c_str(), NULL);
+
+    LOG_ARGS("Opened scan from cache file %s", path.c_str());
+    ADScanPBScanBuffer_t *buffer = this->loadTarget;
+    buffer->mapping = mapping;
+    buffer->mappingSize = st.st_size;
+    buffer->imageData = (uint8_t *)mapping + header.dataOffset;
+    if (header.numTimestamps > 0) buffer->timestampData = (uint8_t *)mapping + header.tsOffset;
+    buffer->numTimestamps = header.numTimestamps;
+    buffer->frameSizeBytes = header.frameSizeBytes;
+    setScanShape(header.numFrames, header.sizeX, header.sizeY, header.colorMode,
+                 header.dataType);
+
+    advanceLoadedFrontier(header.numFrames);
+    updateStatus("Loaded scan from local cache", ADSCANPB_LOG);
+    setIntegerParam(ADScanPB_NumFramesLoaded, header.numFrames);
+    setDoubleParam(ADScanPB_LoadPercent, 100);
+    setIntegerParam(ADScanPB_ScanLoaded, 1);
+    callParamCallbacks();
+    return asynSuccess;
+}
+
+/**
+ * @brief Writes the currently loaded scan to the local cache. The file is written under a
+ * temporary name with the port unlocked, and renamed into place once complete.
+ *
+ * @param key Cache key of the scan
+ */
+void ADScanPB::writeScanCache(const string &key) {
+    const char *functionName = "writeScanCache";
+
+    // Only scans held entirely in memory can be persisted, streamed and compressed scans have no
+    // image buffer
+    if (this->loadTarget->imageData == NULL) return;
+    if (key.size() >= sizeof(((ADScanPBCacheHeader_t *)0)->key)) {
+        WARN("Cache key too long, not caching scan");
+        return;
+    }
+
+    ADScanPBCacheHeader_t header;
+    fillCacheHeader(&header, key, sizeof(header));
+    size_t dataBytes = (size_t)header.numFrames * header.frameSizeBytes;
+
+    string path = getCacheFilePath(key);
+    char tmpPath[600];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%d.tmp", path.c_str(), (int)getpid());
+
+    const uint8_t *imageData = (const uint8_t *)this->loadTarget->imageData;
+    const uint8_t *tsData = (const uint8_t *)this->loadTarget->timestampData;
+    size_t tsBytes = header.numTimestamps * sizeof(double);
+
+    updateStatus("Writing scan to local cache...", ADSCANPB_LOG);
+    unlock();
+
+    bool ok = false;
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        ok = pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+
+        // Write in bounded pieces so that a cancel does not wait on a multi GB write
+        size_t written = 0;
+        while (ok && written < dataBytes && !this->loadCancelRequested) {
+            size_t toWrite = dataBytes - written;
+            if (toWrite > 64 * 1000000) toWrite = 64 * 1000000;
+            ssize_t n = pwrite(fd, imageData + written, toWrite, header.dataOffset + written);
+            if (n <= 0) ok = false;
+            else written += n;
+        }
+        if (ok && tsBytes > 0)
+            ok = pwrite(fd, tsData, tsBytes, header.tsOffset) == (ssize_t)tsBytes;
+        ok = ok && !this->loadCancelRequested && ftruncate(fd, header.tsOffset + tsBytes) == 0;
+        ok = (close(fd) == 0) && ok;
+        ok = ok && rename(tmpPath, path.c_str()) == 0;
+        if (!ok) unlink(tmpPath);
+    }
+
+    lock();
+    if (ok) {
+        LOG_ARGS("Wrote scan to cache file %s", path.c_str());
+        updateStatus("Done", ADSCANPB_LOG);
+        evictScanCache(path);
+    } else if (this->loadCancelRequested) {
+        WARN("Cache file write cancelled");
+    } else {
+        updateStatus("Failed to write scan to local cache", ADSCANPB_WARN);
+    }
+}
+
+/**
+ * @brief Removes least recently used files from the cache directory until the cache fits in
+ * CacheMaxSize, and publishes the resulting cache size.
+ *
+ * @param keepPath Cache file that must not be evicted, typically the one just written
+ */
+void ADScanPB::evictScanCache(const string &keepPath) {
+    const char *functionName = "evictScanCache";
+
+    char cacheDir[256];
+    getStringParam(ADScanPB_CacheDir, 256, cacheDir);
+    if (strlen(cacheDir) == 0) return;
+
+    DIR *dir = opendir(cacheDir);
+    if (dir == NULL) return;
+
+    vector<pair<time_t, string>> entries;
+    vector<size_t> entrySizes;
+    size_t totalBytes = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        string name(entry->d_name);
+        const string ext = ".scanpb";
+        if (name.size() <= ext.size() ||
+            name.compare(name.size() - ext.size(), ext.size(), ext) != 0)
+            continue;
+
+        string path = string(cacheDir) + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) continue;
+        entries.push_back(make_pair(st.st_mtime, path));
+        entrySizes.push_back(st.st_size);
+        totalBytes += st.st_size;
+    }
+    closedir(dir);
+
+    int maxSizeMB;
+    getIntegerParam(ADScanPB_CacheMaxSize, &maxSizeMB);
+    size_t maxBytes = (size_t)maxSizeMB * 1000000;
+
+    // Evict oldest first, by last use
+    vector<size_t> order(entries.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    sort(order.begin(), order.end(),
+         [&](size_t a, size_t b) { return entries[a].first < entries[b].first; });
+    for (size_t i = 0; i < order.size() && totalBytes > maxBytes; i++) {
+        const string &path = entries[order[i]].second;
+        if (path == keepPath) continue;
+        if (unlink(path.c_str()) == 0) {
+            LOG_ARGS("Evicted cache file %s", path.c_str());
+            totalBytes -= entrySizes[order[i]];
+        }
+    }
+
+    setDoubleParam(ADScanPB_CacheSize, totalBytes / 1000000.0);
+    callParamCallbacks();
+}
+
+//-------------------------------------------------------------------------
+// ADScanPB Shared Memory Scan Store
+//-------------------------------------------------------------------------
+
+/**
+ * @brief Maps a scan key to the name of the POSIX shared memory segment the scan is shared in
+ *
+ * @param key Scan key built by buildScanKey
+ * @return Name of the segment
+ */
+string ADScanPB::getSharedSegmentName(const string &key) {
+    char name[64];
+    snprintf(name, sizeof(name), "/adscanpb-%016llx", (unsigned long long)hashScanKey(key));
+    return string(name);
+}
+
+/**
+ * @brief Attempts to attach to a scan another IOC on this host has shared. The scan is mapped
+ * read only, and only its header is mapped writable, to count the IOCs attached to it.
+ *
+ * @param key Scan key of the scan
+ * @param addReference Whether to count this IOC as attached, false if it already holds the
+ * reference taken when it published the segment
+ * @return asynSuccess if attached, asynError if no complete segment holds the scan
+ */
+asynStatus ADScanPB::attachSharedScan(const string &key, bool addReference) {
+    const char *functionName = "attachSharedScan";
+
+    string name = getSharedSegmentName(key);
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return asynError;
+
+    struct stat st;
+    ADScanPBSharedHeader_t *header = NULL;
+    size_t headerSize = sizeof(ADScanPBSharedHeader_t);
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= headerSize) {
+        void *mapping = mmap(NULL, headerSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) header = (ADScanPBSharedHeader_t *)mapping;
+    }
+
+    if (header == NULL) {
+        close(fd);
+        return asynError;
+    }
+
+    // The magic is only written once the publishing IOC has filled in the segment
+    const ADScanPBCacheHeader_t &scanHeader = header->scan;
+    bool valid = memcmp(scanHeader.magic, ADSCANPB_CACHE_MAGIC, sizeof(scanHeader.magic)) == 0 &&
+                 scanHeader.version == ADSCANPB_CACHE_VERSION &&
+                 strncmp(scanHeader.key, key.c_str(), sizeof(scanHeader.key)) == 0 &&
+                 (size_t)st.st_size >= scanHeader.dataOffset + (size_t)scanHeader.numFrames *
+                                                                   scanHeader.frameSizeBytes &&
+                 (size_t)st.st_size >= scanHeader.tsOffset + (size_t)scanHeader.numTimestamps *
+                                                                 sizeof(double);
+    epicsAtomicReadMemoryBarrier();
+
+    // A segment whose last user is removing it can no longer be attached to
+    while (valid && addReference) {
+        int refCount = epicsAtomicGetIntT(&header->refCount);
+        if (refCount < 0) valid = false;
+        else if (epicsAtomicCmpAndSwapIntT(&header->refCount, refCount, refCount + 1) == refCount)
+            break;
+    }
+
+    void *mapping = MAP_FAILED;
+    if (valid) mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        if (valid && addReference) epicsAtomicDecrIntT(&header->refCount);
+        munmap(header, headerSize);
+        return asynError;
+    }
+
+    LOG_ARGS("Attached to shared scan %s", name.c_str());
+    ADScanPBScanBuffer_t *buffer = this->loadTarget;
+    buffer->sharedHeader = header;
+    buffer->sharedHeaderSize = headerSize;
+    buffer->sharedSegmentName = name;
+    buffer->mapping = mapping;
+    buffer->mappingSize = st.st_size;
+    buffer->imageData = (uint8_t *)mapping + scanHeader.dataOffset;
+    if (scanHeader.numTimestamps > 0)
+        buffer->timestampData = (uint8_t *)mapping + scanHeader.tsOffset;
+    buffer->numTimestamps = scanHeader.numTimestamps;
+    buffer->frameSizeBytes = scanHeader.frameSizeBytes;
+    setScanShape(scanHeader.numFrames, scanHeader.sizeX, scanHeader.sizeY, scanHeader.colorMode,
+                 scanHeader.dataType);
+
+    advanceLoadedFrontier(scanHeader.numFrames);
+    if (addReference) updateStatus("Attached to shared scan", ADSCANPB_LOG);
+    if (buffer == this->scan) {
+        setIntegerParam(ADScanPB_SharedAttached, 1);
+        setIntegerParam(ADScanPB_SharedUsers, epicsAtomicGetIntT(&header->refCount));
+    }
+    setIntegerParam(ADScanPB_NumFramesLoaded, scanHeader.numFrames);
+    setDoubleParam(ADScanPB_LoadPercent, 100);
+    setIntegerParam(ADScanPB_ScanLoaded, 1);
+    callParamCallbacks();
+    return asynSuccess;
+}
+
+/**
+ * @brief Copies the scan just loaded into a new shared memory segment for other IOCs on this host
+ * to attach to, and switches this IOC over to it, freeing its own copy. The segment is written
+ * with the port unlocked. If another IOC is already sharing the scan, nothing is done.
+ *
+ * @param key Scan key of the scan
+ */
+void ADScanPB::publishSharedScan(const string &key) {
+    const char *functionName = "publishSharedScan";
+
+    // Only scans read into the heap are shared, mapped cache files already are. Streamed and
+    // compressed scans have no image buffer.
+    ADScanPBScanBuffer_t *buffer = this->loadTarget;
+    if (buffer->imageData == NULL || buffer->mapping != NULL) return;
+    if (key.size() >= sizeof(((ADScanPBCacheHeader_t *)0)->key)) {
+        WARN("Scan key too long, not sharing scan");
+        return;
+    }
+
+    ADScanPBSharedHeader_t header;
+    fillCacheHeader(&header.scan, key, sizeof(header));
+    header.refCount = 1;
+    size_t dataBytes = (size_t)header.scan.numFrames * header.scan.frameSizeBytes;
+    size_t tsBytes = header.scan.numTimestamps * sizeof(double);
+    size_t segmentSize = header.scan.tsOffset + tsBytes;
+
+    string name = getSharedSegmentName(key);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        WARN_ARGS("Shared scan %s already exists, keeping a private copy", name.c_str());
+        return;
+    }
+    void *mapping = MAP_FAILED;
+    if (ftruncate(fd, segmentSize) == 0)
+        mapping = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        updateStatus("Failed to create shared scan", ADSCANPB_WARN);
+        return;
+    }
+
+    updateStatus("Sharing scan...", ADSCANPB_LOG);
+    const uint8_t *imageData = (const uint8_t *)buffer->imageData;
+    const uint8_t *tsData = (const uint8_t *)buffer->timestampData;
+    unlock();
+    memcpy((uint8_t *)mapping + header.scan.dataOffset, imageData, dataBytes);
+    if (tsBytes > 0) memcpy((uint8_t *)mapping + header.scan.tsOffset, tsData, tsBytes);
+
+    // Publish the header, with the magic last so other IOCs never attach to a partial segment
+    char magic[sizeof(header.scan.magic)];
+    memcpy(magic, header.scan.magic, sizeof(magic));
+    memset(header.scan.magic, 0, sizeof(magic));
+    memcpy(mapping, &header, sizeof(header));
+    epicsAtomicWriteMemoryBarrier();
+    memcpy(((ADScanPBSharedHeader_t *)mapping)->scan.magic, magic, sizeof(magic));
+    lock();
+
+    // Switch over to the segment, unless arrays being played back or held downstream may still
+    // reference the private copy. A preloaded scan is not in use yet.
+    void *privateImageData = buffer->imageData;
+    void *privateTsData = buffer->timestampData;
+    bool inUse = buffer == this->scan &&
+                 (this->playback || this->zeroCopyPool->getNumOutstanding() > 0);
+    if (!inUse && attachSharedScan(key, false) == asynSuccess) {
+        munmap(mapping, segmentSize);
+        free(privateImageData);
+        if (privateTsData != NULL) free(privateTsData);
+        LOG_ARGS("Shared scan %s", name.c_str());
+    } else {
+        // Keep the private copy, and hold the segment's reference until the scan is closed
+        LOG_ARGS("Shared scan %s, keeping a private copy while it is in use", name.c_str());
+        buffer->sharedHeader = (ADScanPBSharedHeader_t *)mapping;
+        buffer->sharedHeaderSize = segmentSize;
+        buffer->sharedSegmentName = name;
+        if (buffer == this->scan)
+            setIntegerParam(ADScanPB_SharedUsers,
+                            epicsAtomicGetIntT(&buffer->sharedHeader->refCount));
+    }
+    updateStatus("Done", ADSCANPB_LOG);
+}
+
+/**
+ * @brief Drops this IOC's reference to the shared scan a scan buffer is attached to, removing
+ * the segment if no other IOC is attached. The scan mapping itself is unmapped by freeScanBuffer.
+ *
+ * @param buffer Scan buffer to detach
+ */
+void ADScanPB::detachSharedScan(ADScanPBScanBuffer_t *buffer) {
+    if (buffer->sharedHeader == NULL) return;
+
+    // Only the IOC that moves the count from 0 to -1 removes the segment, so that a new
+    // segment published under the same name is never removed by mistake
+    if (epicsAtomicDecrIntT(&buffer->sharedHeader->refCount) == 0 &&
+        epicsAtomicCmpAndSwapIntT(&buffer->sharedHeader->refCount, 0, -1) == 0)
+        shm_unlink(buffer->sharedSegmentName.c_str());
+
+    munmap(buffer->sharedHeader, buffer->sharedHeaderSize);
+    buffer->sharedHeader = NULL;
+    buffer->sharedHeaderSize = 0;
+    buffer->sharedSegmentName.clear();
+}
+
+static void lockTiledShare(CURL *handle, curl_lock_data data, curl_lock_access access,
+                           void *userptr) {
+    epicsMutexLock((epicsMutexId)userptr);
+}
+
+static void unlockTiledShare(CURL *handle, curl_lock_data data, void *userptr) {
+    epicsMutexUnlock((epicsMutexId)userptr);
+}
+
+/**
+ * @brief Takes an idle Tiled session from the pool, or creates a new one if none are idle. New
+ * sessions negotiate HTTP/2 over TLS where the server supports it, and keep their connections
+ * alive between requests, so a session that is returned to the pool and taken again later does
+ * not repeat the TCP and TLS handshakes.
+ *
+ * @return Session to make requests with, which must be returned with releaseTiledSession
+ */
+cpr::Session *ADScanPB::acquireTiledSession() {
+    epicsMutexLock(this->tiledSessionMutex);
+    if (!this->tiledSessions.empty()) {
+        cpr::Session *session = this->tiledSessions.back();
+        this->tiledSessions.pop_back();
+        epicsMutexUnlock(this->tiledSessionMutex);
+        return session;
+    }
+
+    // Sessions share DNS lookups and TLS session tickets, so that even a new connection resumes
+    // the TLS session of an earlier one
+    if (this->tiledShare == NULL) {
+        this->tiledShare = curl_share_init();
+        curl_share_setopt(this->tiledShare, CURLSHOPT_LOCKFUNC, lockTiledShare);
+        curl_share_setopt(this->tiledShare, CURLSHOPT_UNLOCKFUNC, unlockTiledShare);
+        curl_share_setopt(this->tiledShare, CURLSHOPT_USERDATA, this->tiledShareMutex);
+        curl_share_setopt(this->tiledShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(this->tiledShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+    epicsMutexUnlock(this->tiledSessionMutex);
+
+    cpr::Session *session = new cpr::Session();
+#if LIBCURL_VERSION_NUM >= 0x072F00
+    session->SetHttpVersion(cpr::HttpVersion{cpr::HttpVersionCode::VERSION_2_0_TLS});
+#endif
+    CURL *handle = session->GetCurlHolder()->handle;
+    curl_easy_setopt(handle, CURLOPT_SHARE, this->tiledShare);
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPIDLE, 60L);
+#if LIBCURL_VERSION_NUM >= 0x074100
+    // Scans are often loaded minutes apart, keep idle connections for reuse between them
+    curl_easy_setopt(handle, CURLOPT_MAXAGE_CONN, 3600L);
+#endif
+    return session;
+}
+
+/**
+ * @brief Returns a session to the pool, keeping its connection open for the next request
+ *
+ * @param session Session taken with acquireTiledSession
+ */
+void ADScanPB::releaseTiledSession(cpr::Session *session) {
+    epicsMutexLock(this->tiledSessionMutex);
+    this->tiledSessions.push_back(session);
+    epicsMutexUnlock(this->tiledSessionMutex);
+}
+
+/**
+ * @brief Counts a completed Tiled request, along with any connection it had to open rather than
+ * reuse, and its latency
+ *
+ * @param session Session the request was made with
+ * @param response Response to the request
+ */
+void ADScanPB::recordTiledRequest(cpr::Session *session, const cpr::Response &response) {
+    long connects = 0;
+    curl_easy_getinfo(session->GetCurlHolder()->handle, CURLINFO_NUM_CONNECTS, &connects);
+    this->tiledRequests++;
+    this->tiledConnections += (int)connects;
+    this->tiledLoadRequests++;
+    this->tiledLoadRequestTimeUs += (epicsUInt64)(response.elapsed * 1.0e6);
+}
+
+/**
+ * @brief Publishes the Tiled request and connection counts, and the mean request latency and the
+ * bytes received and decoded during the current load
+ */
+void ADScanPB::publishTiledStats() {
+    setIntegerParam(ADScanPB_TiledRequests, this->tiledRequests);
+    setIntegerParam(ADScanPB_TiledConnections, this->tiledConnections);
+    int requests = this->tiledLoadRequests;
+    if (requests > 0)
+        setDoubleParam(ADScanPB_TiledRequestTime,
+                       this->tiledLoadRequestTimeUs / 1000.0 / requests);
+    setDoubleParam(ADScanPB_TiledWireMB, this->tiledLoadWireBytes / 1000000.0);
+    setDoubleParam(ADScanPB_TiledDecodedMB, this->tiledLoadDecodedBytes / 1000000.0);
+}
+
+/**
+ * @brief Checks whether blocks can be fetched with a content encoding. gzip and zstd are decoded
+ * by libcurl, and depend on how it was built, while blosc is decoded by the driver.
+ *
+ * @param encoding ADScanPBTiledEncoding_t to check
+ * @return true if responses in the encoding can be decoded
+ */
+static bool tiledEncodingSupported(int encoding) {
+    curl_version_info_data *info = curl_version_info(CURLVERSION_NOW);
+    switch (encoding) {
+        case ADSCANPB_TILED_ENCODING_NONE:
+            return true;
+        case ADSCANPB_TILED_ENCODING_GZIP:
+            return (info->features & CURL_VERSION_LIBZ) != 0;
+#ifdef CURL_VERSION_ZSTD
+        case ADSCANPB_TILED_ENCODING_ZSTD:
+            return (info->features & CURL_VERSION_ZSTD) != 0;
+#endif
+#ifdef ADSCANPB_WITH_BLOSC
+        case ADSCANPB_TILED_ENCODING_BLOSC:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Decompresses a blosc encoded block into its destination in the scan buffer
+ *
+ * @param body Encoded response body
+ * @param dest Location in the scan buffer the block is written to
+ * @param expectedBytes Expected size of the decoded block
+ * @return Number of bytes decoded, or 0 if the body is not a valid blosc buffer of the block
+ */
+static size_t decodeBloscBlock(const string &body, void *dest, size_t expectedBytes) {
+#ifdef ADSCANPB_WITH_BLOSC
+    if (body.size() < BLOSC_MIN_HEADER_LENGTH) return 0;
+    size_t nbytes, cbytes, blocksize;
+    blosc_cbuffer_sizes(body.data(), &nbytes, &cbytes, &blocksize);
+    if (nbytes != expectedBytes || cbytes != body.size()) return 0;
+    int decoded = blosc_decompress_ctx(body.data(), dest, expectedBytes, 1);
+    return decoded > 0 ? (size_t)decoded : 0;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Downloads a single tiled block, writing the response body directly to its destination
+ * in the scan buffer as it is received rather than accumulating it in the response first. gzip
+ * and zstd encoded bodies are decoded by libcurl as they arrive, so are also written straight to
+ * the scan buffer. libcurl does not know blosc, so blosc bodies are collected whole, then
+ * decompressed into place.
+ *
+ * @param session Pooled session to make the request with
+ * @param url Full URL of the block, including the block query
+ * @param header Request headers (auth, accept)
+ * @param encoding ADScanPBTiledEncoding_t to ask the server for, which must be supported
+ * @param dest Location in the scan buffer the block is written to
+ * @param expectedBytes Expected size of the block, more data than this aborts the transfer
+ * @param cancel Flag that aborts the transfer when set
+ * @param errorMsg Set to a description of the failure when asynError is returned
+ * @return asynError if the request fails or the block size does not match, asynSuccess otherwise
+ */
+asynStatus ADScanPB::downloadTiledBlock(cpr::Session *session, const string &url,
+                                        const cpr::Header &header, int encoding, void *dest,
+                                        size_t expectedBytes, const std::atomic<bool> &cancel,
+                                        string &errorMsg) {
+    session->SetUrl(cpr::Url{url});
+    CURL *handle = session->GetCurlHolder()->handle;
+
+    // Sessions are pooled, so the encoding is set on every request
+    bool collectBody = encoding == ADSCANPB_TILED_ENCODING_BLOSC;
+    const char *acceptEncoding = NULL;
+    if (encoding == ADSCANPB_TILED_ENCODING_GZIP)
+        acceptEncoding = "gzip";
+    else if (encoding == ADSCANPB_TILED_ENCODING_ZSTD)
+        acceptEncoding = "zstd";
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, acceptEncoding);
+    if (collectBody) {
+        cpr::Header bloscHeader = header;
+        bloscHeader["Accept-Encoding"] = "blosc";
+        session->SetHeader(bloscHeader);
+    } else {
+        session->SetHeader(header);
+    }
+
+    // A blosc buffer holds the block plus a header, and may be slightly larger when the data does
+    // not compress
+    size_t maxBodyBytes = expectedBytes + 32 + expectedBytes / 64;
+    size_t received = 0;
+    bool overflow = false;
+    string errorBody, body;
+
+    cpr::Response data =
+        session->Download(cpr::WriteCallback{[&](string chunk, intptr_t userdata) -> bool {
+            if (cancel) return false;
+
+            // Error responses carry a text body, which must not land in the scan buffer
+            long responseCode = 0;
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &responseCode);
+            if (responseCode != 200) {
+                if (errorBody.size() < 512) errorBody.append(chunk, 0, 512);
+                return true;
+            }
+
+            if (collectBody) {
+                if (body.size() + chunk.size() > maxBodyBytes) {
+                    overflow = true;
+                    return false;
+                }
+                body.append(chunk);
+                return true;
+            }
+
+            if (received + chunk.size() > expectedBytes) {
+                overflow = true;
+                return false;
+            }
+            memcpy((uint8_t *)dest + received, chunk.data(), chunk.size());
+            received += chunk.size();
+            return true;
+        }});
+    recordTiledRequest(session, data);
+
+    // The server may still send a block without the encoding that was asked for
+    string contentEncoding;
+    bool unknownEncoding = false;
+    if (collectBody && data.status_code == 200 && !cancel && !overflow) {
+        contentEncoding = data.header["Content-Encoding"];
+        if (contentEncoding == "blosc") {
+            received = decodeBloscBlock(body, dest, expectedBytes);
+        } else if (contentEncoding.empty() || contentEncoding == "identity") {
+            received = std::min(body.size(), expectedBytes);
+            memcpy(dest, body.data(), received);
+            if (body.size() > expectedBytes) overflow = true;
+        } else {
+            unknownEncoding = true;
+        }
+    }
+
+    curl_off_t wireBytes = 0;
+    curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &wireBytes);
+    this->tiledLoadWireBytes += (epicsUInt64)wireBytes;
+    this->tiledLoadDecodedBytes += received;
+
+    char msg[512];
+    if (cancel) {
+        snprintf(msg, sizeof(msg), "Load cancelled");
+    } else if (overflow) {
+        snprintf(msg, sizeof(msg), "Recv more than the expected %lu bytes for block %s!",
+                 expectedBytes, url.c_str());
+    } else if (data.status_code != 200) {
+        snprintf(msg, sizeof(msg), "%s", errorBody.empty() ? data.error.message.c_str()
+                                                           : errorBody.c_str());
+    } else if (unknownEncoding) {
+        snprintf(msg, sizeof(msg), "Unsupported content encoding %s for block %s!",
+                 contentEncoding.c_str(), url.c_str());
+    } else if (received != expectedBytes) {
+        snprintf(msg, sizeof(msg), "Recv %lu bytes for block %s, expected %lu!", received,
+                 url.c_str(), expectedBytes);
+    } else {
+        return asynSuccess;
+    }
+
+    errorMsg = string(msg);
+    return asynError;
+}
+
+/**
+ * @brief Maps the data type of a Tiled array, as described by its numpy style kind, item size and
+ * endianness, to the NDDataType it is played back as.
+ *
+ * @param dataType_j data_type object from the array structure metadata
+ * @param dataType Set to the matching NDDataType
+ * @param byteSwap Set if the array is stored with the opposite byte order to this host
+ * @return true if the array holds integers or floats of a size that NDArrays support
+ */
+static bool getNDDataTypeFromTiled(const json &dataType_j, NDDataType_t *dataType,
+                                   bool *byteSwap) {
+    if (!dataType_j.is_object()) return false;
+    string kind = dataType_j.value("kind", "u");
+    size_t itemSize = dataType_j.value("itemsize", (size_t)0);
+    string endianness = dataType_j.value("endianness", "not_applicable");
+
+    if (kind == "u" || kind == "i") {
+        bool isSigned = kind == "i";
+        switch (itemSize) {
+            case 1: *dataType = isSigned ? NDInt8 : NDUInt8; break;
+            case 2: *dataType = isSigned ? NDInt16 : NDUInt16; break;
+            case 4: *dataType = isSigned ? NDInt32 : NDUInt32; break;
+            case 8: *dataType = isSigned ? NDInt64 : NDUInt64; break;
+            default: return false;
+        }
+    } else if (kind == "f" && itemSize == 4) {
+        *dataType = NDFloat32;
+    } else if (kind == "f" && itemSize == 8) {
+        *dataType = NDFloat64;
+    } else {
+        return false;
+    }
+
+#if EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG
+    *byteSwap = itemSize > 1 && endianness == "little";
+#else
+    *byteSwap = itemSize > 1 && endianness == "big";
+#endif
+    return true;
+}
+
+/**
+ * @brief Gets where the chunks of a Tiled array start along one of its dimensions
+ *
+ * @param sizes Sizes of the chunks along the dimension, from the structure of the array
+ * @param length Length of the array along the dimension
+ * @param starts Set to the first index of each chunk, followed by the length
+ * @return true if the chunks are not empty and exactly cover the dimension
+ */
+static bool getTiledChunkStarts(const json &sizes, size_t length, vector<size_t> &starts) {
+    starts.assign(1, 0);
+    if (!sizes.is_array()) return false;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        if (!sizes[i].is_number_unsigned() || sizes[i].get<size_t>() == 0) return false;
+        starts.push_back(starts.back() + sizes[i].get<size_t>());
+    }
+    return starts.size() > 1 && starts.back() == length;
+}
+
+asynStatus ADScanPB::openScanTiled(const char *scanID) {
+    const char *functionName = "openScanTiled";
+    asynStatus status = asynSuccess;
+
+    char tiledServerURL[256], metadataURL[512], imageDataset[256], dataPath[256];
+    getStringParam(ADScanPB_TiledServerURL, 256, tiledServerURL);
+    getStringParam(ADScanPB_ExternalPath, 256, dataPath);
+    getStringParam(ADScanPB_ImageDataset, 256, imageDataset);
+    snprintf(metadataURL, 512, "%s/api/v1/metadata/%s/%s/%s", tiledServerURL, dataPath, scanID, imageDataset);
+
+    if (this->tiledApiKey == NULL)
+        updateStatus("No tiled API key was found!", ADSCANPB_WARN);
+
+    LOG_ARGS("Attempting to load img data from scan w/ ID: %s from %s/%s", scanID, tiledServerURL, dataPath);
+
+    // Latency is reported per load, connection and request counts over the driver's lifetime
+    this->tiledLoadRequests = 0;
+    this->tiledLoadRequestTimeUs = 0;
+    this->tiledLoadWireBytes = 0;
+    this->tiledLoadDecodedBytes = 0;
+
+    cpr::Header auth;
+    if (this->tiledApiKey != NULL)
+        auth = cpr::Header{{string("Authorization"), "Apikey " + string(this->tiledApiKey)}};
+
+    // The metadata is fetched over a pooled session too, so its connection is reused for blocks
+    string metadataText;
+    unlock();
+    cpr::Session *session = acquireTiledSession();
+    session->SetUrl(cpr::Url{string(metadataURL)});
+    session->SetHeader(auth);
+    curl_easy_setopt(session->GetCurlHolder()->handle, CURLOPT_ACCEPT_ENCODING, NULL);
+    cpr::Response r = session->Download(cpr::WriteCallback{[&](string chunk, intptr_t userdata) {
+        metadataText.append(chunk);
+        return true;
+    }});
+    recordTiledRequest(session, r);
+    releaseTiledSession(session);
+    lock();
+    publishTiledStats();
+
+    if (r.status_code != 200) {
+        updateStatus(metadataText.empty() ? r.error.message.c_str() : metadataText.c_str(),
+                     ADSCANPB_ERR);
+        return asynError;
+    }
+
+    //cout << r.text << endl;
+
+    json metadata_j = json::parse(metadataText.c_str());
+    json scanShape = metadata_j["data"]["attributes"]["structure"]["shape"];
+
+    // Only arrays of frames of a single component are supported, which is checked before any
+    // sizes are read from the metadata
+    if (!scanShape.is_array() || scanShape.size() != 3 || !scanShape[0].is_number_unsigned() ||
+        !scanShape[1].is_number_unsigned() || !scanShape[2].is_number_unsigned()) {
+        updateStatus("Image array must have 3 dimensions!", ADSCANPB_ERR);
+        return asynError;
+    }
+    size_t datasetFrames = scanShape[0].get<size_t>();
+    size_t ySize = scanShape[1].get<size_t>();
+    size_t xSize = scanShape[2].get<size_t>();
+
+    json dataType_j = metadata_j["data"]["attributes"]["structure"]["data_type"];
+    NDDataType_t dataType;
+    bool byteSwap;
+    if (!getNDDataTypeFromTiled(dataType_j, &dataType, &byteSwap)) {
+        updateStatus("Couldn't read image dataset data type!", ADSCANPB_ERR);
+        return asynError;
+    }
+    size_t bytesPerElem = scanPBBytesPerElement(dataType);
+    json chunks = metadata_j["data"]["attributes"]["structure"]["chunks"];
+
+    // Arrays may be chunked along Y and X as well as by frame, in which case each block of frames
+    // is split into a grid of tiles that are fetched separately
+    vector<size_t> frameStarts, rowStarts, colStarts;
+    if (!chunks.is_array() || chunks.size() != 3 ||
+        !getTiledChunkStarts(chunks[0], datasetFrames, frameStarts) ||
+        !getTiledChunkStarts(chunks[1], ySize, rowStarts) ||
+        !getTiledChunkStarts(chunks[2], xSize, colStarts)) {
+        updateStatus("Couldn't read the chunking of the image array!", ADSCANPB_ERR);
+        return asynError;
+    }
+
+    string dataURL = metadata_j["data"]["links"]["block"];
+    char *dataURLToken = strtok((char *)dataURL.c_str(), "?");
+    dataURL = string(dataURLToken);
+    cout << dataURL << endl;
+    string fullURL = metadata_j["data"]["links"].value("full", string());
+    fullURL = fullURL.substr(0, fullURL.find('?'));
+
+    updateStatus("Loading scan from URL...", ADSCANPB_LOG);
+
+    // Either the active scan, or the next scan when preloading
+    ADScanPBScanBuffer_t *target = this->loadTarget;
+
+    int selectedFrames;
+    if (selectFrames((int)datasetFrames, &selectedFrames) != asynSuccess) return asynError;
+    size_t numFrames = selectedFrames;
+
+    // A region of interest, with a size of 0 extending to the edge of the frame
+    int roiMinX, roiMinY, roiSizeX, roiSizeY;
+    getIntegerParam(ADScanPB_TiledMinX, &roiMinX);
+    getIntegerParam(ADScanPB_TiledMinY, &roiMinY);
+    getIntegerParam(ADScanPB_TiledSizeX, &roiSizeX);
+    getIntegerParam(ADScanPB_TiledSizeY, &roiSizeY);
+    if (roiMinX < 0 || roiMinY < 0 || (size_t)roiMinX >= xSize || (size_t)roiMinY >= ySize) {
+        updateStatus("Tiled region of interest is outside of the frame!", ADSCANPB_ERR);
+        return asynError;
+    }
+    size_t minX = roiMinX, minY = roiMinY;
+    size_t sizeX = roiSizeX > 0 ? std::min((size_t)roiSizeX, xSize - minX) : xSize - minX;
+    size_t sizeY = roiSizeY > 0 ? std::min((size_t)roiSizeY, ySize - minY) : ySize - minY;
+
+    // When cropping, or skipping frames, the server cuts out only the frames and pixels that are
+    // needed with slice queries, rather than whole blocks being fetched. Slices of consecutive
+    // selected frames stand in for blocks, sized to TiledRequestSize.
+    size_t first = target->sourceFirstFrame, stride = target->sourceFrameStride;
+    size_t last = first + (numFrames - 1) * stride;
+    bool sliced = sizeX != xSize || sizeY != ySize || stride > 1;
+    if (sliced && fullURL.empty()) {
+        updateStatus("Tiled server does not support slicing the image array!", ADSCANPB_ERR);
+        return asynError;
+    }
+    char sliceQuery[128] = "";
+    if (sliced) {
+        double requestSizeMB;
+        getDoubleParam(ADScanPB_TiledRequestSize, &requestSizeMB);
+        size_t sliceFrameBytes = sizeX * sizeY * bytesPerElem;
+        size_t framesPerRequest = (size_t)(requestSizeMB * 1000000) / sliceFrameBytes;
+        if (framesPerRequest < 1) framesPerRequest = 1;
+
+        frameStarts.clear();
+        for (size_t frame = first; frame <= last; frame += framesPerRequest * stride)
+            frameStarts.push_back(frame);
+        frameStarts.push_back(last + 1);
+        rowStarts.assign({0, sizeY});
+        colStarts.assign({0, sizeX});
+        snprintf(sliceQuery, sizeof(sliceQuery), ",%lu:%lu,%lu:%lu", (unsigned long)minY,
+                 (unsigned long)(minY + sizeY), (unsigned long)minX,
+                 (unsigned long)(minX + sizeX));
+        LOG_ARGS("Fetching slices of %lu frames of the %lu x %lu region at %lu, %lu",
+                 (unsigned long)framesPerRequest, (unsigned long)sizeX, (unsigned long)sizeY,
+                 (unsigned long)minX, (unsigned long)minY);
+
+        // From here on frames are the region of interest
+        xSize = sizeX;
+        ySize = sizeY;
+    }
+
+    size_t numElems = numFrames * ySize * xSize;
+    size_t datasetSizeBytes = numElems * bytesPerElem;
+    size_t datasetSizeMB = datasetSizeBytes / 1000000;
+    target->frameSizeBytes = ySize * xSize * bytesPerElem;
+
+    int storageMode = getStorageMode();
+    bool compressed = storageMode == ADSCANPB_STORAGE_COMPRESSED;
+
+    // First three channels are always the num frames, height, and then width. Tiled arrays
+    // are always played back as mono.
+    setScanShape((int)numFrames, (int)xSize, (int)ySize, NDColorModeMono, dataType);
+    callParamCallbacks();
+
+    cpr::Header dataHeader = auth;
+    dataHeader["Accept"] = "application/octet-stream";
+
+    int encoding;
+    getIntegerParam(ADScanPB_TiledEncoding, &encoding);
+    if (!tiledEncodingSupported(encoding)) {
+        updateStatus("Tiled encoding not supported by this build, fetching blocks unencoded",
+                     ADSCANPB_WARN);
+        encoding = ADSCANPB_TILED_ENCODING_NONE;
+    }
+
+    // Sliced blocks are numbered from the first selected frame
+    int numSourceBlocks = frameStarts.size() - 1;
+    size_t rowTiles = rowStarts.size() - 1, colTiles = colStarts.size() - 1;
+    size_t tilesPerBlock = rowTiles * colTiles;
+    int concurrency;
+    getIntegerParam(ADScanPB_TiledConcurrency, &concurrency);
+    if (concurrency < 1) concurrency = 1;
+
+    if (storageMode == ADSCANPB_STORAGE_STREAMING) {
+        // Only the metadata is fetched now. The prefetch threads fetch blocks as playback nears
+        // them, and keep them in the block cache.
+        this->tiledStreamURL = sliced ? fullURL : dataURL;
+        this->tiledStreamSlice = sliceQuery;
+        this->tiledStreamHeader = dataHeader;
+        this->tiledStreamEncoding = encoding;
+        this->tiledStreamConcurrency = concurrency;
+        this->tiledStreamByteSwap = byteSwap;
+        this->tiledStreamBytesPerElem = bytesPerElem;
+        this->tiledBlockStarts = frameStarts;
+        this->tiledRowStarts = rowStarts;
+        this->tiledColStarts = colStarts;
+        this->tiledBlocks.assign(numSourceBlocks, NULL);
+
+        int cacheMaxSizeMB, prefetchDepth;
+        double prefetchTime, fps;
+        getIntegerParam(ADScanPB_TiledCacheMaxSize, &cacheMaxSizeMB);
+        getDoubleParam(ADScanPB_TiledPrefetchTime, &prefetchTime);
+        getDoubleParam(ADScanPB_PlaybackRateFPS, &fps);
+        getIntegerParam(ADScanPB_PrefetchDepth, &prefetchDepth);
+        this->tiledCacheMaxBytes = (size_t)std::max(cacheMaxSizeMB, 0) * 1000000;
+        this->tiledPrefetchTime = prefetchTime;
+        this->tiledCacheBytes = 0;
+        this->tiledUseCounter = 0;
+        this->tiledCacheHits = 0;
+        this->tiledCacheMisses = 0;
+        this->tiledReadAheads = 0;
+        this->streamRateFPS = fps;
+        this->tiledStreamStop = false;
+        this->tiledStreaming = true;
+        this->streamNumFrames = (int)numFrames;
+
+        if (startPrefetch(prefetchDepth, concurrency) != asynSuccess) return asynError;
+
+        advanceLoadedFrontier(numFrames);
+        updateStatus("Streaming scan from Tiled", ADSCANPB_LOG);
+        setIntegerParam(ADScanPB_NumFramesLoaded, numFrames);
+        setDoubleParam(ADScanPB_LoadPercent, 100);
+        setIntegerParam(ADScanPB_ScanLoaded, 1);
+        publishTiledStreamStats(0);
+        callParamCallbacks();
+        return status;
+    }
+
+    if (compressed) {
+        // Blocks are compressed as they arrive, so the full scan is never resident uncompressed
+        int prefetchDepth, decompressThreads;
+        getIntegerParam(ADScanPB_PrefetchDepth, &prefetchDepth);
+        getIntegerParam(ADScanPB_DecompressThreads, &decompressThreads);
+        if (startCompressedStore((int)numFrames) != asynSuccess ||
+            startPrefetch(prefetchDepth, decompressThreads) != asynSuccess)
+            return asynError;
+    } else {
+        // allocate buffer for image data & read entire scan into it.
+        LOG_ARGS("Allocating image buffer of size: %d MB", datasetSizeMB);
+        target->imageData = calloc(datasetSizeBytes, 1);
+        if (target->imageData == NULL) {
+            updateStatus("Failed to allocate scan image buffer!", ADSCANPB_ERR);
+            return asynError;
+        }
+    }
+
+    // Only the blocks holding a selected frame are fetched. Precompute which frames of each
+    // block are selected, and where in the scan buffer they are written, so blocks can be
+    // fetched in any order.
+    vector<int> blockIndex;
+    vector<size_t> blockFrames, blockFirstSelected, blockSelectedFrames, blockOffsets;
+    for (int i = 0; i < numSourceBlocks; i++) {
+        size_t blockStart = frameStarts[i];
+        size_t frames = frameStarts[i + 1] - blockStart;
+        size_t blockEnd = std::min(blockStart + frames, last + 1);
+        size_t nextSelected = first;
+        if (blockStart > first) nextSelected += (blockStart - first + stride - 1) / stride * stride;
+        if (nextSelected < blockEnd) {
+            size_t selected = (blockEnd - 1 - nextSelected) / stride + 1;
+            blockIndex.push_back(i);
+            blockFrames.push_back(sliced ? selected : frames);
+            blockFirstSelected.push_back(sliced ? 0 : nextSelected - blockStart);
+            blockSelectedFrames.push_back(selected);
+            blockOffsets.push_back((nextSelected - first) / stride * target->frameSizeBytes);
+        }
+    }
+    int numBlocks = blockIndex.size();
+
+    // Tiles are numbered in row major order over the grid of blocks, rows and columns, and are
+    // handed out in that order, so all tiles of the first blocks are in flight together and
+    // whole frames complete early enough to start playback
+    size_t numTiles = numBlocks * tilesPerBlock;
+
+    LOG_ARGS("Dataset of %lu %lu x %lu images with %lu bytes per pixel, split into %d blocks of "
+             "%lu x %lu tiles.",
+             datasetFrames, xSize, ySize, bytesPerElem, numSourceBlocks, rowTiles, colTiles);
+
+    if ((size_t)concurrency > numTiles) concurrency = (int)numTiles;
+
+    std::atomic<size_t> nextTile(0);
+    std::atomic<int> blocksLoaded(0);
+    std::atomic<size_t> framesLoaded(0);
+    std::atomic<bool> loadFailed(false);
+    std::mutex loadErrorMutex;
+    string loadError;
+
+    // Blocks complete out of order, playback may only proceed up to the first missing block.
+    // When compressing, the selected frames of a block are assembled in a buffer of their own
+    // until all of its tiles are in.
+    std::mutex frontierMutex;
+    vector<bool> blockDone(numBlocks, false);
+    vector<size_t> blockTilesDone(numBlocks, 0);
+    vector<vector<uint8_t>> blockAssembly(compressed ? numBlocks : 0);
+    int frontierBlock = 0, frontierFrames = 0;
+
+    // Each worker pulls the next unclaimed tile, and writes the selected frames in it to their
+    // place in the scan buffer.
+    auto fetchTiles = [&](cpr::Session *session) {
+        vector<uint8_t> tileBuffer;
+        while (!loadFailed && !this->loadCancelRequested) {
+            size_t c = nextTile++;
+            if (c >= numTiles) return;
+            int i = (int)(c / tilesPerBlock);
+            size_t row = c % tilesPerBlock / colTiles, col = c % colTiles;
+
+            char fullURLC[512];
+            if (sliced)
+                snprintf(fullURLC, sizeof(fullURLC), "%s?slice=%lu:%lu:%lu%s", fullURL.c_str(),
+                         (unsigned long)frameStarts[blockIndex[i]],
+                         (unsigned long)frameStarts[blockIndex[i] + 1], (unsigned long)stride,
+                         sliceQuery);
+            else
+                snprintf(fullURLC, sizeof(fullURLC), "%s?block=%d,%lu,%lu", dataURL.c_str(),
+                         blockIndex[i], (unsigned long)row, (unsigned long)col);
+            size_t frameBytes = target->frameSizeBytes;
+            size_t rows = rowStarts[row + 1] - rowStarts[row];
+            size_t cols = colStarts[col + 1] - colStarts[col];
+            size_t tileFrameBytes = rows * cols * bytesPerElem;
+            size_t numBytesToFetch = blockFrames[i] * tileFrameBytes;
+            size_t numBytesToCopy = blockSelectedFrames[i] * frameBytes;
+
+            // Compressed blocks are assembled in a buffer of their own before being compressed
+            uint8_t *dest;
+            if (compressed) {
+                std::lock_guard<std::mutex> guard(frontierMutex);
+                if (blockAssembly[i].empty()) blockAssembly[i].resize(numBytesToCopy);
+                dest = blockAssembly[i].data();
+            } else {
+                dest = (uint8_t *)target->imageData + blockOffsets[i];
+            }
+
+            // Whole blocks with every frame selected are written straight to their destination,
+            // tiles and blocks holding frames that were not selected are staged first
+            bool staged = tilesPerBlock > 1 || blockSelectedFrames[i] != blockFrames[i];
+            if (staged) tileBuffer.resize(numBytesToFetch);
+            uint8_t *blockData = staged ? tileBuffer.data() : dest;
+
+            string blockError;
+            if (downloadTiledBlock(session, string(fullURLC), dataHeader, encoding, blockData,
+                                   numBytesToFetch, this->loadCancelRequested,
+                                   blockError) != asynSuccess) {
+                std::lock_guard<std::mutex> guard(loadErrorMutex);
+                if (!loadFailed) loadError = blockError;
+                loadFailed = true;
+                return;
+            }
+
+            // Blocks arrive in the byte order the array was stored in
+            if (!staged) {
+                if (byteSwap) scanPBByteSwap(dest, numBytesToCopy / bytesPerElem, bytesPerElem);
+            } else {
+                for (size_t f = 0; f < blockSelectedFrames[i]; f++) {
+                    size_t src = (blockFirstSelected[i] + f * stride) * tileFrameBytes;
+                    if (byteSwap)
+                        scanPBByteSwap(blockData + src, tileFrameBytes / bytesPerElem,
+                                       bytesPerElem);
+                    scanPBCopyTile(blockData + src, dest + f * frameBytes, rows, cols,
+                                   rowStarts[row], colStarts[col], xSize, bytesPerElem);
+                }
+            }
+
+            // The worker that brings in the last tile of a block completes it
+            {
+                std::lock_guard<std::mutex> guard(frontierMutex);
+                if (++blockTilesDone[i] < tilesPerBlock) continue;
+            }
+            if (compressed) {
+                asynStatus compressStatus =
+                    compressFrames((int)(blockOffsets[i] / frameBytes),
+                                   (int)blockSelectedFrames[i], dest, 1);
+                vector<uint8_t>().swap(blockAssembly[i]);
+                if (compressStatus != asynSuccess) {
+                    std::lock_guard<std::mutex> guard(loadErrorMutex);
+                    if (!loadFailed) loadError = "Failed to compress image data!";
+                    loadFailed = true;
+                    return;
+                }
+            }
+
+            framesLoaded += blockSelectedFrames[i];
+            blocksLoaded++;
+
+            std::lock_guard<std::mutex> guard(frontierMutex);
+            blockDone[i] = true;
+            while (frontierBlock < numBlocks && blockDone[frontierBlock])
+                frontierFrames += blockSelectedFrames[frontierBlock++];
+            advanceLoadedFrontier(frontierFrames);
+        }
+    };
+
+    // Workers hold on to one session for all of their tiles
+    auto blockWorker = [&]() {
+        cpr::Session *session = acquireTiledSession();
+        fetchTiles(session);
+        releaseTiledSession(session);
+    };
+
+    LOG_ARGS("Fetching %lu tiles of %d blocks with %d concurrent workers", numTiles, numBlocks,
+             concurrency);
+    // Workers get threads of their own rather than sharing cpr's global pool with other ports
+    vector<std::future<void>> workers;
+    for (int i = 0; i < concurrency; i++)
+        workers.push_back(std::async(std::launch::async, blockWorker));
+
+    // Report progress as blocks complete, in whatever order they finish
+    for (size_t i = 0; i < workers.size(); i++) {
+        while (true) {
+            unlock();
+            std::future_status workerStatus = workers[i].wait_for(std::chrono::milliseconds(100));
+            lock();
+            if (workerStatus == std::future_status::ready) break;
+
+            char loadingMsg[256];
+            snprintf(loadingMsg, sizeof(loadingMsg), "Loaded %d of %d blocks...",
+                     (int)blocksLoaded, numBlocks);
+            setStringParam(ADStatusMessage, loadingMsg);
+            setIntegerParam(ADScanPB_NumFramesLoaded, (int)framesLoaded);
+            setDoubleParam(ADScanPB_LoadPercent, 100.0 * framesLoaded / numFrames);
+            publishTiledStats();
+            callParamCallbacks();
+        }
+    }
+    publishTiledStats();
+
+    if (this->loadCancelRequested) {
+        return asynError;
+    } else if (loadFailed) {
+        updateStatus(loadError.c_str(), ADSCANPB_ERR);
+        return asynError;
+    }
+
+    setIntegerParam(ADScanPB_NumFramesLoaded, (int)framesLoaded);
+    setDoubleParam(ADScanPB_LoadPercent, 100.0 * framesLoaded / numFrames);
+    if (compressed && this->compressedBytes > 0)
+        setDoubleParam(ADScanPB_CompressionRatio,
+                       (double)numFrames * target->frameSizeBytes / this->compressedBytes);
+
+    updateStatus("Done", ADSCANPB_LOG);
+    setIntegerParam(ADScanPB_ScanLoaded, 1);
+    callParamCallbacks();
+    return status;
+}
+
+
+/**
+ * @brief Maps the type of an HDF5 image dataset to the NDDataType it is played back as, and the
+ * native type to read it with.
+ *
+ * @param h5Type Type of the image dataset
+ * @param dataType Set to the matching NDDataType
+ * @param nativeType Set to the matching native HDF5 type, which must not be closed
+ * @return true if the dataset holds integers or floats of a size that NDArrays support
+ */
+static bool getNDDataTypeFromHDF5(hid_t h5Type, NDDataType_t *dataType, hid_t *nativeType) {
+    size_t size = H5Tget_size(h5Type);
+    H5T_class_t typeClass = H5Tget_class(h5Type);
+
+    if (typeClass == H5T_INTEGER) {
+        bool isSigned = H5Tget_sign(h5Type) == H5T_SGN_2;
+        switch (size) {
+            case 1:
+                *dataType = isSigned ? NDInt8 : NDUInt8;
+                *nativeType = isSigned ? H5T_NATIVE_INT8 : H5T_NATIVE_UINT8;
+                return true;
+            case 2:
+                *dataType = isSigned ? NDInt16 : NDUInt16;
+                *nativeType = isSigned ? H5T_NATIVE_INT16 : H5T_NATIVE_UINT16;
+                return true;
+            case 4:
+                *dataType = isSigned ? NDInt32 : NDUInt32;
+                *nativeType = isSigned ? H5T_NATIVE_INT32 : H5T_NATIVE_UINT32;
+                return true;
+            case 8:
+                *dataType = isSigned ? NDInt64 : NDUInt64;
+                *nativeType = isSigned ? H5T_NATIVE_INT64 : H5T_NATIVE_UINT64;
+                return true;
+        }
+    } else if (typeClass == H5T_FLOAT) {
+        if (size == 4) {
+            *dataType = NDFloat32;
+            *nativeType = H5T_NATIVE_FLOAT;
+            return true;
+        } else if (size == 8) {
+            *dataType = NDFloat64;
+            *nativeType = H5T_NATIVE_DOUBLE;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Checks whether the chunks of an HDF5 image dataset can be emitted as compressed
+ * NDArrays as is. Each chunk must hold exactly one frame in the byte order of the host, and be
+ * compressed with a single filter whose chunk format is understood by ADCore codecs.
+ *
+ * @param datasetId Image dataset
+ * @param fileType Type of the image dataset as stored in the file
+ * @param nativeType Native type the dataset is played back as
+ * @param ndims Number of dimensions of the dataset
+ * @param dims Size of each dimension of the dataset
+ * @param codec Set to the codec of the chunks
+ * @return true if the chunks can be emitted as is
+ */
+static bool getDirectChunkCodec(hid_t datasetId, hid_t fileType, hid_t nativeType, int ndims,
+                                const hsize_t *dims, ADScanPBStoreCodec_t *codec) {
+    if (H5Tget_order(fileType) != H5Tget_order(nativeType)) return false;
+
+    hid_t dcpl = H5Dget_create_plist(datasetId);
+    bool supported = H5Pget_layout(dcpl) == H5D_CHUNKED && H5Pget_nfilters(dcpl) == 1;
+
+    hsize_t chunkDims[4];
+    if (supported && (ndims < 3 || ndims > 4 || H5Pget_chunk(dcpl, ndims, chunkDims) != ndims))
+        supported = false;
+    for (int i = 0; supported && i < ndims; i++)
+        if (chunkDims[i] != (i == 0 ? 1 : dims[i])) supported = false;
+
+    unsigned int flags, cdValues[16];
+    size_t numCdValues = 16;
+    H5Z_filter_t filter = -1;
+    if (supported)
+        filter = H5Pget_filter2(dcpl, 0, &flags, &numCdValues, cdValues, 0, NULL, NULL);
+    H5Pclose(dcpl);
+
+    // Filters record their settings in the dataset when it is created
+    if (filter == ADSCANPB_H5Z_FILTER_BITSHUFFLE && numCdValues >= 6 &&
+        cdValues[5] == ADSCANPB_BITSHUFFLE_LZ4) {
+        *codec = {NDCODEC_BSLZ4, 0, 0, 0};
+        return true;
+    } else if (filter == ADSCANPB_H5Z_FILTER_BLOSC && numCdValues >= 7) {
+        *codec = {NDCODEC_BLOSC, (int)cdValues[4], (int)cdValues[5], (int)cdValues[6]};
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Gets the chunking of an HDF5 image dataset, and checks that the driver can reverse every
+ * filter applied to its chunks. Chunks may split the dataset along any dimension but color.
+ *
+ * @param datasetId Image dataset
+ * @param ndims Number of dimensions of the dataset
+ * @param dims Size of each dimension of the dataset
+ * @param layout Set to the chunk dimensions and filter pipeline of the dataset
+ * @return true if the dataset is chunked and all of its filters are supported
+ */
+static bool getChunkLayout(hid_t datasetId, int ndims, const hsize_t *dims,
+                           ADScanPBChunkLayout_t *layout) {
+    if (ndims < 3 || ndims > 4) return false;
+
+    hid_t dcpl = H5Dget_create_plist(datasetId);
+    bool supported = H5Pget_layout(dcpl) == H5D_CHUNKED &&
+                     H5Pget_chunk(dcpl, ndims, layout->chunkDims) == ndims &&
+                     (ndims == 3 || layout->chunkDims[3] == dims[3]);
+
+    int numFilters = supported ? H5Pget_nfilters(dcpl) : 0;
+    layout->filters.clear();
+    for (int i = 0; i < numFilters && supported; i++) {
+        unsigned int flags, cdValues[16];
+        size_t numCdValues = 16;
+        H5Z_filter_t filter =
+            H5Pget_filter2(dcpl, i, &flags, &numCdValues, cdValues, 0, NULL, NULL);
+        switch (filter) {
+            case H5Z_FILTER_SHUFFLE:
+            case H5Z_FILTER_DEFLATE:
+                break;
+#ifdef ADSCANPB_WITH_BLOSC
+            case ADSCANPB_H5Z_FILTER_BLOSC:
+                break;
+#endif
+#ifdef ADSCANPB_WITH_BITSHUFFLE
+            case ADSCANPB_H5Z_FILTER_BITSHUFFLE:
+                supported = numCdValues >= 6 && cdValues[5] == ADSCANPB_BITSHUFFLE_LZ4;
+                break;
+#endif
+            default:
+                supported = false;
+        }
+        layout->filters.push_back(filter);
+    }
+    H5Pclose(dcpl);
+
+    layout->ndims = ndims;
+    for (int i = 0; i < ndims; i++) layout->dims[i] = dims[i];
+    return supported;
+}
+
+/**
+ * @brief Reverses the filter pipeline of a chunk read with H5Dread_chunk, in the opposite order
+ * the filters were applied in. Filters that were skipped for the chunk are skipped here too.
+ *
+ * @param layout Filter pipeline of the dataset
+ * @param filterMask Filters skipped for the chunk, as returned by H5Dread_chunk
+ * @param chunk Chunk as stored, replaced by the decoded chunk
+ * @param scratch Buffer the filters are reversed into, reused between chunks
+ * @param chunkBytes Size of the decoded chunk
+ * @return true if the chunk was decoded to exactly chunkBytes bytes
+ */
+static bool decodeChunk(const ADScanPBChunkLayout_t &layout, uint32_t filterMask,
+                        vector<uint8_t> &chunk, vector<uint8_t> &scratch, size_t chunkBytes) {
+    size_t elemSize = layout.elemSize;
+
+    for (int i = (int)layout.filters.size() - 1; i >= 0; i--) {
+        if (filterMask & (1u << i)) continue;
+
+        scratch.resize(chunkBytes);
+        bool decoded = false;
+        switch (layout.filters[i]) {
+            case H5Z_FILTER_SHUFFLE:
+                if (chunk.size() == chunkBytes) {
+                    scanPBByteUnshuffle(chunk.data(), scratch.data(), chunkBytes / elemSize,
+                                        elemSize);
+                    decoded = true;
+                }
+                break;
+            case H5Z_FILTER_DEFLATE: {
+                uLongf decodedSize = chunkBytes;
+                decoded = uncompress(scratch.data(), &decodedSize, chunk.data(), chunk.size()) ==
+                              Z_OK &&
+                          decodedSize == chunkBytes;
+                break;
+            }
+#ifdef ADSCANPB_WITH_BLOSC
+            case ADSCANPB_H5Z_FILTER_BLOSC:
+                decoded = blosc_decompress_ctx(chunk.data(), scratch.data(), chunkBytes, 1) ==
+                          (int)chunkBytes;
+                break;
+#endif
+#ifdef ADSCANPB_WITH_BITSHUFFLE
+            case ADSCANPB_H5Z_FILTER_BITSHUFFLE: {
+                // Chunks start with the big endian decoded size, and block size in bytes
+                if (chunk.size() < 12) break;
+                uint64_t totalSize = 0;
+                uint32_t blockSize = 0;
+                for (int b = 0; b < 8; b++) totalSize = (totalSize << 8) | chunk[b];
+                for (int b = 8; b < 12; b++) blockSize = (blockSize << 8) | chunk[b];
+                decoded = totalSize == chunkBytes &&
+                          bshuf_decompress_lz4(chunk.data() + 12, scratch.data(),
+                                               chunkBytes / elemSize, elemSize,
+                                               blockSize / elemSize) >= 0;
+                break;
+            }
+#endif
+        }
+        if (!decoded) return false;
+        chunk.swap(scratch);
+    }
+    return chunk.size() == chunkBytes;
+}
+
+/**
+ * @brief Reads a chunked HDF5 image dataset into the scan buffer with a pool of workers. Each
+ * worker reads the raw bytes of a chunk, holding the HDF5 library only for the read, then
+ * decodes it and copies the selected frames in it into place. Blocks of frames without a
+ * selected frame are skipped. Chunks complete out of order, and the loaded frontier advances
+ * past a block of frames once all of its chunks are in.
+ *
+ * @param datasetId Image dataset
+ * @param layout Chunking and filter pipeline of the dataset, from getChunkLayout
+ * @return asynError if a chunk could not be read or decoded, or the load was cancelled
+ */
+asynStatus ADScanPB::readChunksParallelHDF5(hid_t datasetId, const ADScanPBChunkLayout_t &layout) {
+    const char *functionName = "readChunksParallelHDF5";
+
+    const hsize_t *dims = layout.dims;
+    const hsize_t *chunkDims = layout.chunkDims;
+    size_t pixelBytes = layout.elemSize * (layout.ndims == 4 ? dims[3] : 1);
+    size_t chunkBytes = chunkDims[0] * chunkDims[1] * chunkDims[2] * pixelBytes;
+
+    ADScanPBScanBuffer_t *target = this->loadTarget;
+    hsize_t first = target->sourceFirstFrame;
+    hsize_t stride = target->sourceFrameStride;
+    hsize_t last = first + (hsize_t)(target->numFrames - 1) * stride;
+
+    // Blocks of frames that hold a selected frame, and the number of selected frames up to the
+    // end of each of them
+    vector<hsize_t> blocks;
+    vector<int> blockFramesEnd;
+    for (hsize_t block = first / chunkDims[0]; block <= last / chunkDims[0]; block++) {
+        hsize_t blockStart = block * chunkDims[0];
+        hsize_t blockEnd = std::min(blockStart + chunkDims[0], last + 1);
+        hsize_t nextSelected = first;
+        if (blockStart > first) nextSelected += (blockStart - first + stride - 1) / stride * stride;
+        if (nextSelected >= blockEnd) continue;
+        blocks.push_back(block);
+        blockFramesEnd.push_back((int)((blockEnd - 1 - first) / stride + 1));
+    }
+
+    // Chunks are numbered in row major order over the grid of blocks, rows and columns
+    size_t grid[3];
+    for (int i = 0; i < 3; i++) grid[i] = (dims[i] + chunkDims[i] - 1) / chunkDims[i];
+    size_t chunksPerBlock = grid[1] * grid[2];
+    size_t numChunks = blocks.size() * chunksPerBlock;
+
+    int loadThreads;
+    getIntegerParam(ADScanPB_LoadThreads, &loadThreads);
+    if (loadThreads < 1) loadThreads = epicsThreadGetCPUs();
+    if ((size_t)loadThreads > numChunks) loadThreads = (int)numChunks;
+
+    LOG_ARGS("Reading %lu chunks of %lu frames with %d workers", (unsigned long)numChunks,
+             (unsigned long)chunkDims[0], loadThreads);
+
+    std::atomic<size_t> nextChunk(0), chunksLoaded(0);
+    std::atomic<bool> loadFailed(false);
+
+    // Frames are loaded once every chunk of their block of frames is in
+    std::mutex frontierMutex;
+    vector<size_t> blockChunksDone(blocks.size(), 0);
+    size_t frontierBlock = 0;
+    int framesLoaded = 0;
+
+    auto chunkWorker = [&]() {
+        vector<uint8_t> chunk, scratch;
+        while (!loadFailed && !this->loadCancelRequested) {
+            size_t c = nextChunk++;
+            if (c >= numChunks) return;
+
+            size_t block = c / chunksPerBlock;
+            hsize_t offset[4] = {blocks[block] * chunkDims[0],
+                                 (c % chunksPerBlock) / grid[2] * chunkDims[1],
+                                 c % grid[2] * chunkDims[2], 0};
+
+            // The HDF5 library is not thread safe, so only one worker reads at a time
+            hsize_t storedSize = 0;
+            uint32_t filterMask = 0;
+            bool readOk;
+            {
+                std::lock_guard<std::mutex> guard(this->h5Mutex);
+                readOk = H5Dget_chunk_storage_size(datasetId, offset, &storedSize) >= 0;
+                chunk.resize(storedSize);
+                if (readOk && storedSize > 0)
+                    readOk = H5Dread_chunk(datasetId, H5P_DEFAULT, offset, &filterMask,
+                                           chunk.data()) >= 0;
+            }
+
+            // Chunks that were never written are left filled with zeros
+            if (readOk && storedSize > 0) {
+                readOk = decodeChunk(layout, filterMask, chunk, scratch, chunkBytes);
+                if (readOk && layout.byteSwap)
+                    scanPBByteSwap(chunk.data(), chunkBytes / layout.elemSize, layout.elemSize);
+            }
+            if (!readOk) {
+                loadFailed = true;
+                return;
+            }
+
+            // Chunks at the edges of the dataset extend past it
+            if (storedSize > 0) {
+                size_t frames = std::min(chunkDims[0], dims[0] - offset[0]);
+                size_t rows = std::min(chunkDims[1], dims[1] - offset[1]);
+                size_t rowBytes = std::min(chunkDims[2], dims[2] - offset[2]) * pixelBytes;
+                for (size_t f = 0; f < frames; f++) {
+                    hsize_t sourceFrame = offset[0] + f;
+                    if (sourceFrame < first || sourceFrame > last ||
+                        (sourceFrame - first) % stride != 0)
+                        continue;
+                    size_t frame = (sourceFrame - first) / stride;
+                    for (size_t y = 0; y < rows; y++) {
+                        size_t dst = (frame * dims[1] + offset[1] + y) * dims[2] + offset[2];
+                        size_t src = (f * chunkDims[1] + y) * chunkDims[2];
+                        memcpy((uint8_t *)target->imageData + dst * pixelBytes,
+                               chunk.data() + src * pixelBytes, rowBytes);
+                    }
+                }
+            }
+            chunksLoaded++;
+
+            std::lock_guard<std::mutex> guard(frontierMutex);
+            blockChunksDone[block]++;
+            while (frontierBlock < blocks.size() &&
+                   blockChunksDone[frontierBlock] == chunksPerBlock)
+                framesLoaded = blockFramesEnd[frontierBlock++];
+            advanceLoadedFrontier(framesLoaded);
+        }
+    };
+
+    vector<std::future<void>> workers;
+    for (int i = 0; i < loadThreads; i++)
+        workers.push_back(std::async(std::launch::async, chunkWorker));
+
+    // Report progress as chunks complete, in whatever order they finish
+    for (size_t i = 0; i < workers.size(); i++) {
+        while (true) {
+            unlock();
+            std::future_status workerStatus = workers[i].wait_for(std::chrono::milliseconds(100));
+            lock();
+            if (workerStatus == std::future_status::ready) break;
+
+            setIntegerParam(ADScanPB_NumFramesLoaded, this->loadedFrontier);
+            setDoubleParam(ADScanPB_LoadPercent, 100.0 * chunksLoaded / numChunks);
+            callParamCallbacks();
+        }
+    }
+
+    if (this->loadCancelRequested) return asynError;
+    if (loadFailed) {
+        updateStatus("Failed to read image data from scan file!", ADSCANPB_ERR);
+        return asynError;
+    }
+
+    setIntegerParam(ADScanPB_NumFramesLoaded, target->numFrames);
+    setDoubleParam(ADScanPB_LoadPercent, 100);
+    callParamCallbacks();
+    return asynSuccess;
+}
+
+asynStatus ADScanPB::openScanHDF5(const char *fileName) {
+    const char *functionName = "openScanHDF5";
+    asynStatus status = asynSuccess;
+
+    hid_t fileId, imageDatasetId, tsDatasetId;
+
+    char directoryPath[256], fullFilePath[512];
+    getStringParam(ADScanPB_ExternalPath, 256, (char *)directoryPath);
     snprintf(fullFilePath, 512, "%s/%s", directoryPath, fileName);
 
     LOG_ARGS("Attempting to open HDF5 file: %s", fullFilePath);
 
+    // Held for every HDF5 call, and released while waiting on other threads, so that a scan
+    // streaming from another file keeps being read during a preload
+    std::unique_lock<std::mutex> h5Lock(this->h5Mutex);
+
     // Open H5 file and
     fileId = H5Fopen(fullFilePath, H5F_ACC_RDONLY, H5P_DEFAULT);
 
@@ -769,25 +4525,8 @@ asynStatus ADScanPB::openScanHDF5(const char *fileName) {
         return asynError;
     }
 
-    char timestampDataset[256];
-    getStringParam(ADScanPB_TSDataset, 256, (char *)timestampDataset);
-    if (strlen(timestampDataset) > 0) {
-        tsDatasetId = H5Dopen(fileId, timestampDataset, H5P_DEFAULT);
-
-        if (tsDatasetId < 0) {
-            WARN("Timestamp dataset could not be opened");
-        } else {
-            hid_t dspace = H5Dget_space(tsDatasetId);
-            hsize_t dims[1];
-            H5Sget_simple_extent_dims(dspace, dims, NULL);
-            H5Dclose(dspace);
-
-            scanTimestampDataBuffer = calloc(dims[0], sizeof(double));
-            H5Dread(tsDatasetId, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                    (double *)this->scanTimestampDataBuffer);
-            H5Dclose(tsDatasetId);
-        }
-    }
+    // Either the active scan, or the next scan when preloading
+    ADScanPBScanBuffer_t *target = this->loadTarget;
 
     // Collect image dataset dimension information.
     hid_t dspace = H5Dget_space(imageDatasetId);
@@ -806,64 +4545,249 @@ asynStatus ADScanPB::openScanHDF5(const char *fileName) {
         LOG_ARGS("Detected image dataset with %d dimensions.", ndims);
     }
 
-    // Calculate total number of elements (pixels) in image dataset
-    size_t num_elems = 1;
-    for (int i = 0; i < ndims; i++) {
-        num_elems = num_elems * dims[i];
+    // Calculate number of elements (pixels) in each frame
+    size_t frameElems = 1;
+    for (int i = 1; i < ndims; i++) {
+        frameElems = frameElems * dims[i];
     }
 
-    // Number of frames in scan will always be the first dimension
-    hsize_t numFrames = dims[0];
-
-    updateStatus("Loading scan file...", ADSCANPB_LOG);
+    // Number of frames in scan will always be the first dimension, of which only the selected
+    // frames are loaded
+    int selectedFrames;
+    if (selectFrames((int)dims[0], &selectedFrames) != asynSuccess) {
+        H5Dclose(imageDatasetId);
+        H5Fclose(fileId);
+        return asynError;
+    }
+    hsize_t numFrames = selectedFrames;
+    hsize_t firstFrame = target->sourceFirstFrame;
+    hsize_t frameStride = target->sourceFrameStride;
 
-    // First three channels are always the num frames, height, and then width
-    setIntegerParam(ADScanPB_NumFrames, numFrames);
-    setIntegerParam(ADMaxSizeX, (int)dims[2]);
-    setIntegerParam(ADSizeX, (int)dims[2]);
-    setIntegerParam(ADMaxSizeY, (int)dims[1]);
-    setIntegerParam(ADSizeY, (int)dims[1]);
+    char timestampDataset[256];
+    getStringParam(ADScanPB_TSDataset, 256, (char *)timestampDataset);
+    if (strlen(timestampDataset) > 0) {
+        tsDatasetId = H5Dopen(fileId, timestampDataset, H5P_DEFAULT);
 
-    // determine whether or not the image data is in color or not.
-    if (ndims == 4) {
-        setIntegerParam(NDColorMode, NDColorModeRGB1);
-    } else {
-        setIntegerParam(NDColorMode, NDColorModeMono);
+        if (tsDatasetId < 0) {
+            WARN("Timestamp dataset could not be opened");
+        } else {
+            // Read the timestamps of the selected frames, as far as the dataset goes
+            hid_t tsSpace = H5Dget_space(tsDatasetId);
+            hsize_t tsDims[1];
+            H5Sget_simple_extent_dims(tsSpace, tsDims, NULL);
+            hsize_t tsStart[1] = {firstFrame}, tsStride[1] = {frameStride}, tsCount[1] = {0};
+            if (tsDims[0] > firstFrame)
+                tsCount[0] = std::min(numFrames, (tsDims[0] - firstFrame - 1) / frameStride + 1);
+
+            if (tsCount[0] > 0) {
+                H5Sselect_hyperslab(tsSpace, H5S_SELECT_SET, tsStart, tsStride, tsCount, NULL);
+                hid_t tsMemSpace = H5Screate_simple(1, tsCount, NULL);
+                target->timestampData = calloc(tsCount[0], sizeof(double));
+                target->numTimestamps = (int)tsCount[0];
+                H5Dread(tsDatasetId, H5T_NATIVE_DOUBLE, tsMemSpace, tsSpace, H5P_DEFAULT,
+                        (double *)target->timestampData);
+                H5Sclose(tsMemSpace);
+            }
+            H5Sclose(tsSpace);
+            H5Dclose(tsDatasetId);
+        }
     }
 
-    // Determine datatype of image data, and populate corresponding PVs
+    updateStatus("Loading scan file...", ADSCANPB_LOG);
+
+    // Determine datatype of image data, and populate corresponding PVs. The data is read as the
+    // equivalent native type, so HDF5 converts it from whatever byte order it was stored in.
     hid_t h5_dtype = H5Dget_type(imageDatasetId);
-    size_t dtype_size;
-    if (H5Tequal(h5_dtype, H5T_NATIVE_UINT8) || H5Tequal(h5_dtype, H5T_NATIVE_UCHAR)) {
-        setIntegerParam(NDDataType, NDUInt8);
-        dtype_size = sizeof(uint8_t);
-    } else if (H5Tequal(h5_dtype, H5T_NATIVE_UINT16)) {
-        setIntegerParam(NDDataType, NDUInt16);
-        dtype_size = sizeof(uint16_t);
-    } else {
+    NDDataType_t dataType;
+    hid_t nativeDtype;
+    if (!getNDDataTypeFromHDF5(h5_dtype, &dataType, &nativeDtype)) {
         updateStatus("Couldn't read image dataset data type!", ADSCANPB_ERR);
         H5Dclose(imageDatasetId);
-        H5Dclose(tsDatasetId);
         H5Tclose(h5_dtype);
         H5Fclose(fileId);
-        closeScan();
         return asynError;
     }
+    // The compressed store belongs to the active scan, so preloads are never read as stored, even
+    // if EmitCompressed was set after the preload started
+    int emitCompressed;
+    ADScanPBStoreCodec_t chunkCodec;
+    getIntegerParam(ADScanPB_EmitCompressed, &emitCompressed);
+    bool preload = target != this->scan;
+    bool directChunks = !preload && emitCompressed == 1 &&
+                        getDirectChunkCodec(imageDatasetId, h5_dtype, nativeDtype, ndims, dims,
+                                            &chunkCodec);
+    if (emitCompressed == 1 && !directChunks)
+        updateStatus("Image dataset chunks can't be emitted as is, emitting uncompressed arrays",
+                     ADSCANPB_WARN);
+
+    bool fileByteSwap = H5Tget_order(h5_dtype) != H5Tget_order(nativeDtype);
+    H5Tclose(h5_dtype);
+    h5_dtype = H5Tcopy(nativeDtype);
+    size_t dtype_size = H5Tget_size(h5_dtype);
 
+    // First three channels are always the num frames, height, and then width, with a fourth
+    // channel for color data.
+    setScanShape((int)numFrames, (int)dims[2], (int)dims[1],
+                 ndims == 4 ? NDColorModeRGB1 : NDColorModeMono, dataType);
     callParamCallbacks();
 
-    // allocate buffer for image data & read entire scan into it.
-    this->scanImageDataBuffer = calloc(num_elems, dtype_size);
-    H5Dread(imageDatasetId, h5_dtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, this->scanImageDataBuffer);
+    target->frameSizeBytes = frameElems * dtype_size;
+
+    if (directChunks) {
+        h5Lock.unlock();
+        status = loadChunksHDF5(imageDatasetId, (int)numFrames, ndims);
+        h5Lock.lock();
+        this->storeCodec = chunkCodec;
+        H5Tclose(h5_dtype);
+        H5Dclose(imageDatasetId);
+        H5Fclose(fileId);
+        if (status != asynSuccess) return status;
+
+        setDoubleParam(ADScanPB_CompressionRatio,
+                       (double)numFrames * target->frameSizeBytes / this->compressedBytes);
+        updateStatus("Done", ADSCANPB_LOG);
+        setIntegerParam(ADScanPB_ScanLoaded, 1);
+        callParamCallbacks();
+        return status;
+    }
+
+    int storageMode = getStorageMode();
+    if (storageMode == ADSCANPB_STORAGE_STREAMING) {
+        // Keep the file open, and let the prefetch thread read frames ahead of playback
+        this->streamFileId = fileId;
+        this->streamDatasetId = imageDatasetId;
+        this->streamDtypeId = h5_dtype;
+        this->streamNumFrames = (int)numFrames;
+        h5Lock.unlock();
+
+        int prefetchDepth;
+        getIntegerParam(ADScanPB_PrefetchDepth, &prefetchDepth);
+        if (startPrefetch(prefetchDepth, 1) != asynSuccess) return asynError;
+
+        advanceLoadedFrontier(numFrames);
+        updateStatus("Streaming scan file", ADSCANPB_LOG);
+        setIntegerParam(ADScanPB_NumFramesLoaded, numFrames);
+        setDoubleParam(ADScanPB_LoadPercent, 100);
+        setIntegerParam(ADScanPB_ScanLoaded, 1);
+        callParamCallbacks();
+        return status;
+    }
+
+    // Read the scan in batches of frames so that progress can be reported, and so playback can
+    // begin before the whole scan is resident.
+    hsize_t framesPerRead = (64 * 1000000) / target->frameSizeBytes;
+    if (framesPerRead < 1) framesPerRead = 1;
+
+    // Compressed scans are read a batch at a time into a staging buffer, and compressed from there
+    bool compressed = storageMode == ADSCANPB_STORAGE_COMPRESSED;
+    std::vector<uint8_t> batchBuffer;
+    int decompressThreads = 1;
+    if (compressed) {
+        getIntegerParam(ADScanPB_DecompressThreads, &decompressThreads);
+        int prefetchDepth;
+        getIntegerParam(ADScanPB_PrefetchDepth, &prefetchDepth);
+        if (startCompressedStore((int)numFrames) != asynSuccess ||
+            startPrefetch(prefetchDepth, decompressThreads) != asynSuccess) {
+            H5Tclose(h5_dtype);
+            H5Dclose(imageDatasetId);
+            H5Fclose(fileId);
+            return asynError;
+        }
+        batchBuffer.resize(std::min(framesPerRead, numFrames) * target->frameSizeBytes);
+    } else {
+        // allocate buffer for image data & read entire scan into it.
+        target->imageData = calloc(numFrames * frameElems, dtype_size);
+        if (target->imageData == NULL) {
+            updateStatus("Failed to allocate scan image buffer!", ADSCANPB_ERR);
+            H5Tclose(h5_dtype);
+            H5Dclose(imageDatasetId);
+            H5Fclose(fileId);
+            return asynError;
+        }
+    }
+
+    // Chunked datasets are read chunk by chunk in parallel, decoding chunks on many cores
+    ADScanPBChunkLayout_t chunkLayout;
+    chunkLayout.elemSize = dtype_size;
+    chunkLayout.byteSwap = fileByteSwap && dtype_size > 1;
+    if (!compressed && getChunkLayout(imageDatasetId, ndims, dims, &chunkLayout)) {
+        h5Lock.unlock();
+        status = readChunksParallelHDF5(imageDatasetId, chunkLayout);
+        h5Lock.lock();
+        H5Tclose(h5_dtype);
+        H5Dclose(imageDatasetId);
+        H5Fclose(fileId);
+        if (status != asynSuccess) return status;
+
+        updateStatus("Done", ADSCANPB_LOG);
+        setIntegerParam(ADScanPB_ScanLoaded, 1);
+        callParamCallbacks();
+        return status;
+    }
+
+    // Strided selections are read with a strided hyperslab, so HDF5 skips the frames in between
+    hid_t fspace = H5Dget_space(imageDatasetId);
+    hsize_t start[ndims], stride[ndims], count[ndims];
+    for (int i = 0; i < ndims; i++) {
+        start[i] = 0;
+        stride[i] = 1;
+        count[i] = dims[i];
+    }
+    stride[0] = frameStride;
+
+    for (hsize_t frame = 0; frame < numFrames; frame += framesPerRead) {
+        if (this->loadCancelRequested) {
+            status = asynError;
+            break;
+        }
+
+        start[0] = firstFrame + frame * frameStride;
+        count[0] = (numFrames - frame < framesPerRead) ? numFrames - frame : framesPerRead;
+        H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, stride, count, NULL);
+        hid_t mspace = H5Screate_simple(ndims, count, NULL);
+
+        void *dest = compressed
+                         ? (void *)batchBuffer.data()
+                         : (uint8_t *)target->imageData + frame * target->frameSizeBytes;
+        unlock();
+        herr_t err = H5Dread(imageDatasetId, h5_dtype, mspace, fspace, H5P_DEFAULT, dest);
+        H5Sclose(mspace);
+        h5Lock.unlock();
+        asynStatus compressStatus = asynSuccess;
+        if (err >= 0 && compressed)
+            compressStatus = compressFrames((int)frame, (int)count[0], dest, decompressThreads);
+        lock();
+        h5Lock.lock();
+
+        if (err < 0) {
+            updateStatus("Failed to read image data from scan file!", ADSCANPB_ERR);
+            status = asynError;
+            break;
+        }
+        if (compressStatus != asynSuccess) {
+            updateStatus("Failed to compress image data!", ADSCANPB_ERR);
+            status = asynError;
+            break;
+        }
+
+        int framesLoaded = (int)(frame + count[0]);
+        advanceLoadedFrontier(framesLoaded);
+        setIntegerParam(ADScanPB_NumFramesLoaded, framesLoaded);
+        setDoubleParam(ADScanPB_LoadPercent, 100.0 * framesLoaded / numFrames);
+        callParamCallbacks();
+    }
+    H5Sclose(fspace);
 
     H5Tclose(h5_dtype);
 
     H5Dclose(imageDatasetId);
     H5Fclose(fileId);
+    if (status != asynSuccess) return status;
+
+    if (compressed && this->compressedBytes > 0)
+        setDoubleParam(ADScanPB_CompressionRatio,
+                       (double)numFrames * target->frameSizeBytes / this->compressedBytes);
     updateStatus("Done", ADSCANPB_LOG);
-    // H5Dread does not offer any progress indicators.
-    setIntegerParam(ADScanPB_NumFramesLoaded, numFrames);
-    setDoubleParam(ADScanPB_LoadPercent, 100);
     setIntegerParam(ADScanPB_ScanLoaded, 1);
     callParamCallbacks();
     return status;
@@ -922,22 +4846,37 @@ asynStatus ADScanPB::writeOctet(asynUser *pasynUser, const char *value, size_t n
 
     if (function == ADScanPB_ScanID) {
         if ((nChars > 0) && (value[0] != 0)) {
-            // If we have a scan loaded already, close it out first
-            int scanLoaded;
-            getIntegerParam(ADScanPB_ScanLoaded, &scanLoaded);
-            if (scanLoaded == 1) closeScan();
-
-            int dataSource;
-            getIntegerParam(ADScanPB_DataSource, &dataSource);
-            if (dataSource == ADSCANPB_DS_HDF5) status = this->openScanHDF5(value);
-            else if (dataSource == 1)
-                status = this->openScanTiled(value);
-            else
-                updateStatus("Selected data source not supported in current ADScanPB build!",
-                             ADSCANPB_ERR);
+            // Loading a scan by hand takes over from the playlist
+            stopPlaylist();
+            setIntegerParam(ADScanPB_PlaylistEnable, 0);
+            status = startLoad(value);
+        }
+    }
+
+    else if (function == ADScanPB_NextScanID) {
+        if ((nChars > 0) && (value[0] != 0)) {
+            stopPlaylist();
+            setIntegerParam(ADScanPB_PlaylistEnable, 0);
+            status = startPreload(value);
+        }
+    }
+
+    else if (function == ADScanPB_Playlist) {
+        if ((nChars > 0) && (value[0] != 0)) {
+            status = parsePlaylist(string(value, strnlen(value, nChars)));
+        }
+    }
+
+    else if (function == ADScanPB_PlaylistFile) {
+        if ((nChars > 0) && (value[0] != 0)) {
+            status = readPlaylistFile(value);
         }
     }
 
+    else if (function == ADScanPB_CacheDir) {
+        evictScanCache(string());
+    }
+
     else if (function < ADSCANPB_FIRST_PARAM) {
         /* If this parameter belongs to a base class call its method */
         status = ADDriver::writeOctet(pasynUser, value, nChars, nActual);
@@ -1002,6 +4941,9 @@ ADScanPB::ADScanPB(const char *portName, int maxBuffers, size_t maxMemory, int p
     createParam(ADScanPB_DatasetSizeString, asynParamOctet, &ADScanPB_DatasetSize);
     createParam(ADScanPB_TSDatasetString, asynParamOctet, &ADScanPB_TSDataset);
     createParam(ADScanPB_TSDatasetDescString, asynParamOctet, &ADScanPB_TSDatasetDesc);
+    createParam(ADScanPB_FirstFrameString, asynParamInt32, &ADScanPB_FirstFrame);
+    createParam(ADScanPB_LastFrameString, asynParamInt32, &ADScanPB_LastFrame);
+    createParam(ADScanPB_FrameStrideString, asynParamInt32, &ADScanPB_FrameStride);
     createParam(ADScanPB_TiledServerURLString, asynParamOctet, &ADScanPB_TiledServerURL);
     createParam(ADScanPB_DataSourceString, asynParamInt32, &ADScanPB_DataSource);
     createParam(ADScanPB_AutoRepeatString, asynParamInt32, &ADScanPB_AutoRepeat);
@@ -1018,6 +4960,83 @@ ADScanPB::ADScanPB(const char *portName, int maxBuffers, size_t maxMemory, int p
     createParam(ADScanPB_TriggerSignalString, asynParamInt32, &ADScanPB_TriggerSignal);
     createParam(ADScanPB_NumTrigsRecdString, asynParamInt32, &ADScanPB_NumTrigsRecd);
     createParam(ADScanPB_NumTrigsDroppedString, asynParamInt32, &ADScanPB_NumTrigsDropped);
+    createParam(ADScanPB_StorageModeString, asynParamInt32, &ADScanPB_StorageMode);
+    createParam(ADScanPB_PrefetchDepthString, asynParamInt32, &ADScanPB_PrefetchDepth);
+    createParam(ADScanPB_PrefetchLevelString, asynParamInt32, &ADScanPB_PrefetchLevel);
+    createParam(ADScanPB_StreamStallsString, asynParamInt32, &ADScanPB_StreamStalls);
+    createParam(ADScanPB_MeasuredFPSString, asynParamFloat64, &ADScanPB_MeasuredFPS);
+    createParam(ADScanPB_TiledConcurrencyString, asynParamInt32, &ADScanPB_TiledConcurrency);
+    createParam(ADScanPB_TiledRequestsString, asynParamInt32, &ADScanPB_TiledRequests);
+    createParam(ADScanPB_TiledConnectionsString, asynParamInt32, &ADScanPB_TiledConnections);
+    createParam(ADScanPB_TiledRequestTimeString, asynParamFloat64, &ADScanPB_TiledRequestTime);
+    createParam(ADScanPB_TiledEncodingString, asynParamInt32, &ADScanPB_TiledEncoding);
+    createParam(ADScanPB_TiledWireMBString, asynParamFloat64, &ADScanPB_TiledWireMB);
+    createParam(ADScanPB_TiledDecodedMBString, asynParamFloat64, &ADScanPB_TiledDecodedMB);
+    createParam(ADScanPB_TiledCacheMaxSizeString, asynParamInt32, &ADScanPB_TiledCacheMaxSize);
+    createParam(ADScanPB_TiledCacheSizeString, asynParamFloat64, &ADScanPB_TiledCacheSize);
+    createParam(ADScanPB_TiledPrefetchTimeString, asynParamFloat64, &ADScanPB_TiledPrefetchTime);
+    createParam(ADScanPB_TiledCacheHitRateString, asynParamFloat64, &ADScanPB_TiledCacheHitRate);
+    createParam(ADScanPB_TiledPrefetchLeadString, asynParamInt32, &ADScanPB_TiledPrefetchLead);
+    createParam(ADScanPB_TiledMinXString, asynParamInt32, &ADScanPB_TiledMinX);
+    createParam(ADScanPB_TiledMinYString, asynParamInt32, &ADScanPB_TiledMinY);
+    createParam(ADScanPB_TiledSizeXString, asynParamInt32, &ADScanPB_TiledSizeX);
+    createParam(ADScanPB_TiledSizeYString, asynParamInt32, &ADScanPB_TiledSizeY);
+    createParam(ADScanPB_TiledRequestSizeString, asynParamFloat64, &ADScanPB_TiledRequestSize);
+    createParam(ADScanPB_LoadStateString, asynParamInt32, &ADScanPB_LoadState);
+    createParam(ADScanPB_CancelLoadString, asynParamInt32, &ADScanPB_CancelLoad);
+    createParam(ADScanPB_ProgressivePlaybackString, asynParamInt32, &ADScanPB_ProgressivePlayback);
+    createParam(ADScanPB_ProgressiveMinFramesString, asynParamInt32, &ADScanPB_ProgressiveMinFrames);
+    createParam(ADScanPB_CacheEnableString, asynParamInt32, &ADScanPB_CacheEnable);
+    createParam(ADScanPB_CacheDirString, asynParamOctet, &ADScanPB_CacheDir);
+    createParam(ADScanPB_CacheMaxSizeString, asynParamInt32, &ADScanPB_CacheMaxSize);
+    createParam(ADScanPB_CacheSizeString, asynParamFloat64, &ADScanPB_CacheSize);
+    createParam(ADScanPB_CacheHitsString, asynParamInt32, &ADScanPB_CacheHits);
+    createParam(ADScanPB_CacheMissesString, asynParamInt32, &ADScanPB_CacheMisses);
+    createParam(ADScanPB_ZeroCopyString, asynParamInt32, &ADScanPB_ZeroCopy);
+    createParam(ADScanPB_ZeroCopyOutstandingString, asynParamInt32, &ADScanPB_ZeroCopyOutstanding);
+    createParam(ADScanPB_PacingSpinTailString, asynParamFloat64, &ADScanPB_PacingSpinTail);
+    createParam(ADScanPB_PacingLatenessString, asynParamFloat64, &ADScanPB_PacingLateness);
+    createParam(ADScanPB_PacingJitterString, asynParamFloat64, &ADScanPB_PacingJitter);
+    createParam(ADScanPB_PlaybackTimingString, asynParamInt32, &ADScanPB_PlaybackTiming);
+    createParam(ADScanPB_PlaybackSpeedString, asynParamFloat64, &ADScanPB_PlaybackSpeed);
+    createParam(ADScanPB_MaxGapString, asynParamFloat64, &ADScanPB_MaxGap);
+    createParam(ADScanPB_PipelineDepthString, asynParamInt32, &ADScanPB_PipelineDepth);
+    createParam(ADScanPB_PipelineOccupancyString, asynParamInt32, &ADScanPB_PipelineOccupancy);
+    createParam(ADScanPB_PipelineStallsString, asynParamInt32, &ADScanPB_PipelineStalls);
+    createParam(ADScanPB_BurstFramesString, asynParamInt32, &ADScanPB_BurstFrames);
+    createParam(ADScanPB_BurstDurationString, asynParamFloat64, &ADScanPB_BurstDuration);
+    createParam(ADScanPB_MeasuredGBpsString, asynParamFloat64, &ADScanPB_MeasuredGBps);
+    createParam(ADScanPB_AllocFailuresString, asynParamInt32, &ADScanPB_AllocFailures);
+    createParam(ADScanPB_KernelTimeString, asynParamFloat64, &ADScanPB_KernelTime);
+    createParam(ADScanPB_KernelGBpsString, asynParamFloat64, &ADScanPB_KernelGBps);
+    createParam(ADScanPB_OutputDataTypeString, asynParamInt32, &ADScanPB_OutputDataType);
+    createParam(ADScanPB_ConvertScaleString, asynParamFloat64, &ADScanPB_ConvertScale);
+    createParam(ADScanPB_ConvertOffsetString, asynParamFloat64, &ADScanPB_ConvertOffset);
+    createParam(ADScanPB_CompressCodecString, asynParamInt32, &ADScanPB_CompressCodec);
+    createParam(ADScanPB_CompressLevelString, asynParamInt32, &ADScanPB_CompressLevel);
+    createParam(ADScanPB_DecompressThreadsString, asynParamInt32, &ADScanPB_DecompressThreads);
+    createParam(ADScanPB_CompressionRatioString, asynParamFloat64, &ADScanPB_CompressionRatio);
+    createParam(ADScanPB_DecompressGBpsString, asynParamFloat64, &ADScanPB_DecompressGBps);
+    createParam(ADScanPB_DecompressFPSString, asynParamFloat64, &ADScanPB_DecompressFPS);
+    createParam(ADScanPB_DecompressKeepingUpString, asynParamInt32,
+                &ADScanPB_DecompressKeepingUp);
+    createParam(ADScanPB_EmitCompressedString, asynParamInt32, &ADScanPB_EmitCompressed);
+    createParam(ADScanPB_LoadThreadsString, asynParamInt32, &ADScanPB_LoadThreads);
+    createParam(ADScanPB_SharedMemoryString, asynParamInt32, &ADScanPB_SharedMemory);
+    createParam(ADScanPB_SharedAttachedString, asynParamInt32, &ADScanPB_SharedAttached);
+    createParam(ADScanPB_SharedUsersString, asynParamInt32, &ADScanPB_SharedUsers);
+    createParam(ADScanPB_NextScanIDString, asynParamOctet, &ADScanPB_NextScanID);
+    createParam(ADScanPB_NextScanReadyString, asynParamInt32, &ADScanPB_NextScanReady);
+    createParam(ADScanPB_SwapScanString, asynParamInt32, &ADScanPB_SwapScan);
+    createParam(ADScanPB_AutoSwapString, asynParamInt32, &ADScanPB_AutoSwap);
+    createParam(ADScanPB_PlaylistString, asynParamOctet, &ADScanPB_Playlist);
+    createParam(ADScanPB_PlaylistFileString, asynParamOctet, &ADScanPB_PlaylistFile);
+    createParam(ADScanPB_PlaylistEnableString, asynParamInt32, &ADScanPB_PlaylistEnable);
+    createParam(ADScanPB_PlaylistLoopString, asynParamInt32, &ADScanPB_PlaylistLoop);
+    createParam(ADScanPB_PlaylistLengthString, asynParamInt32, &ADScanPB_PlaylistLength);
+    createParam(ADScanPB_PlaylistIndexString, asynParamInt32, &ADScanPB_PlaylistIndex);
+    createParam(ADScanPB_PlaylistPassString, asynParamInt32, &ADScanPB_PlaylistPass);
+    createParam(ADScanPB_PlaylistUnderrunsString, asynParamInt32, &ADScanPB_PlaylistUnderruns);
 
     LOG("Identifying supported data sources...");
     int supportedDataSources = 0;
@@ -1049,6 +5068,27 @@ ADScanPB::ADScanPB(const char *portName, int maxBuffers, size_t maxMemory, int p
     else ERR("Tiled server url environment variable unset!");
 
     setIntegerParam(ADScanPB_SupportedSources, supportedDataSources);
+    setDoubleParam(ADScanPB_PlaybackSpeed, 1.0);
+    setDoubleParam(ADScanPB_ConvertScale, 1.0);
+    setIntegerParam(ADScanPB_CompressLevel, 5);
+    setIntegerParam(ADScanPB_DecompressThreads, 4);
+    setIntegerParam(ADScanPB_LastFrame, -1);
+    setIntegerParam(ADScanPB_FrameStride, 1);
+    setIntegerParam(ADScanPB_TiledRequests, 0);
+    setIntegerParam(ADScanPB_TiledConnections, 0);
+    setDoubleParam(ADScanPB_TiledRequestTime, 0.0);
+    setDoubleParam(ADScanPB_TiledWireMB, 0.0);
+    setDoubleParam(ADScanPB_TiledDecodedMB, 0.0);
+    setIntegerParam(ADScanPB_TiledCacheMaxSize, 1024);
+    setDoubleParam(ADScanPB_TiledPrefetchTime, 2.0);
+    setDoubleParam(ADScanPB_TiledCacheSize, 0.0);
+    setDoubleParam(ADScanPB_TiledCacheHitRate, 0.0);
+    setIntegerParam(ADScanPB_TiledPrefetchLead, 0);
+    setIntegerParam(ADScanPB_TiledMinX, 0);
+    setIntegerParam(ADScanPB_TiledMinY, 0);
+    setIntegerParam(ADScanPB_TiledSizeX, 0);
+    setIntegerParam(ADScanPB_TiledSizeY, 0);
+    setDoubleParam(ADScanPB_TiledRequestSize, 16.0);
 
     int dataSource;
     getIntegerParam(ADScanPB_DataSource, &dataSource);
@@ -1059,6 +5099,32 @@ ADScanPB::ADScanPB(const char *portName, int maxBuffers, size_t maxMemory, int p
     this->risingEdgeEventId = epicsEventCreate(epicsEventEmpty);
     this->fallingEdgeEventId = epicsEventCreate(epicsEventEmpty);
 
+    // create synchronization primitives for the streaming prefetch ring
+    this->prefetchMutex = epicsMutexCreate();
+    this->prefetchWakeEventId = epicsEventCreate(epicsEventEmpty);
+    this->prefetchFrameReadyEventId = epicsEventCreate(epicsEventEmpty);
+
+    // create event used to wake up playback when the background loader makes progress
+    this->loadProgressEventId = epicsEventCreate(epicsEventEmpty);
+
+    // create mutex guarding the swap of the active and next scans
+    this->scanSwapMutex = epicsMutexCreate();
+    this->tiledSessionMutex = epicsMutexCreate();
+    this->tiledShareMutex = epicsMutexCreate();
+    this->tiledStreamMutex = epicsMutexCreate();
+    this->tiledBlockReadyEventId = epicsEventCreate(epicsEventEmpty);
+
+    // start the thread that moves playlists along as their entries are loaded
+    this->playlistEventId = epicsEventCreate(epicsEventEmpty);
+    epicsThreadOpts opts = EPICS_THREAD_OPTS_INIT;
+    opts.priority = epicsThreadPriorityMedium;
+    opts.stackSize = epicsThreadGetStackSize(epicsThreadStackMedium);
+    opts.joinable = 1;
+    this->playlistThreadId =
+        epicsThreadCreateOpt("playlistThread", (EPICSTHREADFUNC)playlistThreadC, this, &opts);
+
+    this->zeroCopyPool = new ADScanPBArrayPool(this);
+
     // when epics is exited, delete the instance of this class
     epicsAtExit(exitCallbackC, this);
 }
@@ -1066,7 +5132,34 @@ ADScanPB::ADScanPB(const char *portName, int maxBuffers, size_t maxMemory, int p
 ADScanPB::~ADScanPB() {
     const char *functionName = "~ADScanPB";
     LOG("Shutting down scan playback tool...");
-    closeScan();
+    lock();
+    this->playlistThreadRunning = false;
+    this->playlistActive = false;
+    epicsEventSignal(this->playlistEventId);
+    unlock();
+    epicsThreadMustJoin(this->playlistThreadId);
+
+    lock();
+    cancelLoad();
+    if (this->playback) acquireStop();
+    // Zero-copy arrays still held downstream point into the scan buffers, and are returned to
+    // the pool when released, so both are leaked rather than freed out from under them
+    int outstanding = this->zeroCopyPool->getNumOutstanding();
+    if (outstanding > 0) {
+        WARN_ARGS("%d zero-copy arrays still held downstream, leaking scan buffers", outstanding);
+        releaseScanStorage();
+    } else {
+        closeScan();
+        freeScanBuffer(this->nextScan);
+        delete this->zeroCopyPool;
+        this->zeroCopyPool = NULL;
+    }
+    unlock();
+
+    // Sessions must be cleaned up before the caches they share
+    for (size_t i = 0; i < this->tiledSessions.size(); i++) delete this->tiledSessions[i];
+    this->tiledSessions.clear();
+    if (this->tiledShare != NULL) curl_share_cleanup(this->tiledShare);
     LOG("Done.");
 }
 
@@ -24,6 +24,9 @@
 
 #define TRIG_TIMEOUT 5
 
+// Maximum number of frame periods playback will try to catch up on after falling behind
+#define PACING_MAX_CATCHUP_FRAMES 10
+
 typedef enum ADScanPBErr {
     ADSCANPB_LOG = 0,
     ADSCANPB_WARN = 1,
@@ -49,8 +52,59 @@ typedef enum ADScanPBErr {
 #define ADScanPB_TSDatasetString "TS_DATASET"        //
 #define ADScanPB_TSDatasetDescString "TS_DATASET_DESC"        //
 
+#define ADScanPB_FirstFrameString "FIRST_FRAME"
+#define ADScanPB_LastFrameString "LAST_FRAME"
+#define ADScanPB_FrameStrideString "FRAME_STRIDE"
+
 
 #define ADScanPB_TiledServerURLString "TILED_SERVER_URL"
+#define ADScanPB_TiledConcurrencyString "TILED_CONCURRENCY"
+#define ADScanPB_TiledRequestsString "TILED_REQUESTS"
+#define ADScanPB_TiledConnectionsString "TILED_CONNECTIONS"
+#define ADScanPB_TiledRequestTimeString "TILED_REQUEST_TIME"
+#define ADScanPB_TiledEncodingString "TILED_ENCODING"
+#define ADScanPB_TiledWireMBString "TILED_WIRE_MB"
+#define ADScanPB_TiledDecodedMBString "TILED_DECODED_MB"
+#define ADScanPB_TiledCacheMaxSizeString "TILED_CACHE_MAX_SIZE"
+#define ADScanPB_TiledCacheSizeString "TILED_CACHE_SIZE"
+#define ADScanPB_TiledPrefetchTimeString "TILED_PREFETCH_TIME"
+#define ADScanPB_TiledCacheHitRateString "TILED_CACHE_HIT_RATE"
+#define ADScanPB_TiledPrefetchLeadString "TILED_PREFETCH_LEAD"
+#define ADScanPB_TiledMinXString "TILED_MIN_X"
+#define ADScanPB_TiledMinYString "TILED_MIN_Y"
+#define ADScanPB_TiledSizeXString "TILED_SIZE_X"
+#define ADScanPB_TiledSizeYString "TILED_SIZE_Y"
+#define ADScanPB_TiledRequestSizeString "TILED_REQUEST_SIZE"
+
+#define ADScanPB_LoadStateString "LOAD_STATE"
+#define ADScanPB_CancelLoadString "CANCEL_LOAD"
+#define ADScanPB_ProgressivePlaybackString "PROGRESSIVE_PLAYBACK"
+#define ADScanPB_ProgressiveMinFramesString "PROGRESSIVE_MIN_FRAMES"
+
+#define ADScanPB_CacheEnableString "CACHE_ENABLE"
+#define ADScanPB_CacheDirString "CACHE_DIR"
+#define ADScanPB_CacheMaxSizeString "CACHE_MAX_SIZE"
+#define ADScanPB_CacheSizeString "CACHE_SIZE"
+#define ADScanPB_CacheHitsString "CACHE_HITS"
+#define ADScanPB_CacheMissesString "CACHE_MISSES"
+#define ADScanPB_SharedMemoryString "SHARED_MEMORY"
+#define ADScanPB_SharedAttachedString "SHARED_ATTACHED"
+#define ADScanPB_SharedUsersString "SHARED_USERS"
+#define ADScanPB_NextScanIDString "NEXT_SCAN_ID"
+#define ADScanPB_NextScanReadyString "NEXT_SCAN_READY"
+#define ADScanPB_SwapScanString "SWAP_SCAN"
+#define ADScanPB_AutoSwapString "AUTO_SWAP"
+#define ADScanPB_PlaylistString "PLAYLIST"
+#define ADScanPB_PlaylistFileString "PLAYLIST_FILE"
+#define ADScanPB_PlaylistEnableString "PLAYLIST_ENABLE"
+#define ADScanPB_PlaylistLoopString "PLAYLIST_LOOP"
+#define ADScanPB_PlaylistLengthString "PLAYLIST_LENGTH"
+#define ADScanPB_PlaylistIndexString "PLAYLIST_INDEX"
+#define ADScanPB_PlaylistPassString "PLAYLIST_PASS"
+#define ADScanPB_PlaylistUnderrunsString "PLAYLIST_UNDERRUNS"
+
+#define ADScanPB_ZeroCopyString "ZERO_COPY"
+#define ADScanPB_ZeroCopyOutstandingString "ZERO_COPY_OUTSTANDING"
 
 
 #define ADScanPB_TriggerEdgeString "TRIG_EDGE"
@@ -63,6 +117,38 @@ typedef enum ADScanPBErr {
 #define ADScanPB_SupportedSourcesString "SUPPORTED_SOURCES"
 #define ADScanPB_NumFramesLoadedString "NUM_FRAMES_LOADED"
 #define ADScanPB_LoadPercentString "PERCENT_LOADED"
+#define ADScanPB_StorageModeString "STORAGE_MODE"
+#define ADScanPB_PrefetchDepthString "PREFETCH_DEPTH"
+#define ADScanPB_PrefetchLevelString "PREFETCH_LEVEL"
+#define ADScanPB_StreamStallsString "STREAM_STALLS"
+#define ADScanPB_MeasuredFPSString "MEASURED_FPS"
+#define ADScanPB_PacingSpinTailString "PACING_SPIN_TAIL"
+#define ADScanPB_PacingLatenessString "PACING_LATENESS"
+#define ADScanPB_PacingJitterString "PACING_JITTER"
+#define ADScanPB_PlaybackTimingString "PLAYBACK_TIMING"
+#define ADScanPB_PlaybackSpeedString "PLAYBACK_SPEED"
+#define ADScanPB_MaxGapString "MAX_GAP"
+#define ADScanPB_PipelineDepthString "PIPELINE_DEPTH"
+#define ADScanPB_PipelineOccupancyString "PIPELINE_OCCUPANCY"
+#define ADScanPB_PipelineStallsString "PIPELINE_STALLS"
+#define ADScanPB_BurstFramesString "BURST_FRAMES"
+#define ADScanPB_BurstDurationString "BURST_DURATION"
+#define ADScanPB_MeasuredGBpsString "MEASURED_GBPS"
+#define ADScanPB_AllocFailuresString "ALLOC_FAILURES"
+#define ADScanPB_KernelTimeString "KERNEL_TIME"
+#define ADScanPB_KernelGBpsString "KERNEL_GBPS"
+#define ADScanPB_OutputDataTypeString "OUTPUT_DATA_TYPE"
+#define ADScanPB_ConvertScaleString "CONVERT_SCALE"
+#define ADScanPB_ConvertOffsetString "CONVERT_OFFSET"
+#define ADScanPB_CompressCodecString "COMPRESS_CODEC"
+#define ADScanPB_CompressLevelString "COMPRESS_LEVEL"
+#define ADScanPB_DecompressThreadsString "DECOMPRESS_THREADS"
+#define ADScanPB_CompressionRatioString "COMPRESSION_RATIO"
+#define ADScanPB_DecompressGBpsString "DECOMPRESS_GBPS"
+#define ADScanPB_DecompressFPSString "DECOMPRESS_FPS"
+#define ADScanPB_DecompressKeepingUpString "DECOMPRESS_KEEPING_UP"
+#define ADScanPB_EmitCompressedString "EMIT_COMPRESSED"
+#define ADScanPB_LoadThreadsString "LOAD_THREADS"
 
 // Triggering records
 #define ADScanPB_TriggerEdgeString "TRIG_EDGE"
@@ -77,8 +163,17 @@ typedef enum ADScanPBErr {
 // Place any required inclues here
 
 #include "ADDriver.h"
+#include "ADScanPBKernels.h"
 
+#include <epicsEvent.h>
+#include <epicsMessageQueue.h>
+#include <epicsMutex.h>
+#include <hdf5.h>
+
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "cpr/cpr.h"
 #include "json.hpp"
@@ -103,6 +198,44 @@ typedef enum {
     ADSCANPB_DS_MP4 = 4,
 } ADScanPBDataSource_t;
 
+typedef enum {
+    ADSCANPB_STORAGE_IN_MEMORY = 0,  // Entire scan is read into RAM at load time
+    ADSCANPB_STORAGE_STREAMING = 1,  // Frames are read on demand into a bounded prefetch ring
+    ADSCANPB_STORAGE_COMPRESSED = 2,  // Frames are held compressed in RAM, and decompressed into
+                                      // the prefetch ring ahead of playback
+} ADScanPBStorageMode_t;
+
+typedef enum {
+    ADSCANPB_CODEC_LZ4 = 0,   // Blosc with bitshuffle and LZ4
+    ADSCANPB_CODEC_ZSTD = 1,  // Blosc with bitshuffle and Zstd
+} ADScanPBCompressCodec_t;
+
+typedef enum {
+    ADSCANPB_TILED_ENCODING_NONE = 0,   // Blocks are sent as raw bytes
+    ADSCANPB_TILED_ENCODING_GZIP = 1,
+    ADSCANPB_TILED_ENCODING_ZSTD = 2,
+    ADSCANPB_TILED_ENCODING_BLOSC = 3,  // Only if built with blosc
+} ADScanPBTiledEncoding_t;
+
+typedef enum {
+    ADSCANPB_TIMING_FIXED_RATE = 0,  // Frames are emitted every acquire period
+    ADSCANPB_TIMING_TIMESTAMPS = 1,  // Frames are emitted with the deltas of the timestamp dataset
+    ADSCANPB_TIMING_UNTHROTTLED = 2,  // Frames are emitted back to back, as fast as possible
+} ADScanPBPlaybackTiming_t;
+
+// Output data type is either the scan's own type, or an NDDataType_t offset by one
+typedef enum {
+    ADSCANPB_OUTPUT_TYPE_NATIVE = 0,
+} ADScanPBOutputType_t;
+
+typedef enum {
+    ADSCANPB_LOAD_IDLE = 0,
+    ADSCANPB_LOAD_LOADING = 1,
+    ADSCANPB_LOAD_LOADED = 2,
+    ADSCANPB_LOAD_FAILED = 3,
+    ADSCANPB_LOAD_CANCELLED = 4,
+} ADScanPBLoadState_t;
+
 typedef enum {
     ADSCANPB_TIFF = 0,
     ADSCANPB_JPEG = 1,
@@ -119,6 +252,161 @@ typedef enum {
 
 // Place any in use Data structures here
 
+// Single frame of the compressed scan store
+typedef struct ADScanPBCompressedFrame {
+    void *data;  // Blosc compressed frame, NULL until the frame is loaded
+    size_t size;
+} ADScanPBCompressedFrame_t;
+
+// Codec of the frames in the compressed store, set on arrays that are emitted compressed
+typedef struct ADScanPBStoreCodec {
+    NDCodecCompressor_t codec;
+    int level;
+    int shuffle;
+    int compressor;  // Blosc compressor, only used with NDCODEC_BLOSC
+} ADScanPBStoreCodec_t;
+
+// Chunking and filter pipeline of an HDF5 image dataset that is loaded chunk by chunk
+typedef struct ADScanPBChunkLayout {
+    int ndims;
+    hsize_t dims[4];
+    hsize_t chunkDims[4];
+    std::vector<H5Z_filter_t> filters;  // In the order they were applied when writing
+    size_t elemSize;
+    bool byteSwap;  // Dataset is stored in the opposite byte order to the host
+} ADScanPBChunkLayout_t;
+
+// Single slot of the streaming prefetch ring
+typedef struct ADScanPBRingSlot {
+    int frame;  // Index of the frame held in the slot, -1 if empty
+    bool ready; // Set once the frame has been fully read into the slot
+    int pins;   // Non-zero while the playback thread is copying out of the slot
+    void *data;
+} ADScanPBRingSlot_t;
+
+// Block of a streamed Tiled scan, held in the block cache
+typedef struct ADScanPBTiledBlock {
+    std::vector<uint8_t> data;  // Every frame of the block, in the byte order of the host
+    bool ready;                 // Cleared while the block is being fetched
+    epicsUInt64 lastUsed;       // Value of the use counter when last read, for LRU eviction
+} ADScanPBTiledBlock_t;
+
+// Layout of the NDArrays emitted during playback
+typedef struct ADScanPBFrameFormat {
+    int ndims;
+    size_t dims[3];
+    NDDataType_t dataType;     // Data type of the emitted arrays
+    NDDataType_t srcDataType;  // Data type of the frames in the scan
+    int colorMode;
+    bool zeroCopy;  // Arrays reference the scan buffer rather than a copy of it
+    bool transform;  // Frames are cropped, binned, flipped or converted on the way out
+    bool compressed;  // Arrays carry frames of the compressed store as is, with the codec set
+    ADScanPBGeometry_t geometry;
+    ADScanPBConversion_t conversion;
+    size_t frameBytes;  // Size of each emitted frame
+} ADScanPBFrameFormat_t;
+
+// Prepared frame queued by the pipeline thread for the playback thread
+typedef struct ADScanPBPipelineItem {
+    NDArray *pArray;
+    int frame;
+    int generation;  // Pipeline generation the frame was prepared in, stale frames are dropped
+} ADScanPBPipelineItem_t;
+
+#define ADSCANPB_CACHE_MAGIC "ADSCANPB"
+#define ADSCANPB_CACHE_VERSION 1
+
+// Header at the start of each local scan cache file. Image data begins at the page aligned
+// dataOffset, and is followed by numTimestamps doubles at tsOffset.
+typedef struct ADScanPBCacheHeader {
+    char magic[8];
+    int version;
+    int numFrames;
+    int sizeX;
+    int sizeY;
+    int dataType;
+    int colorMode;
+    int numTimestamps;
+    size_t frameSizeBytes;
+    size_t dataOffset;
+    size_t tsOffset;
+    char key[1024];  // Full cache key, guards against hash collisions
+} ADScanPBCacheHeader_t;
+
+// Header at the start of each shared memory scan segment. The rest of the segment is laid out
+// like a cache file. The magic is written last, once the segment is complete.
+typedef struct ADScanPBSharedHeader {
+    ADScanPBCacheHeader_t scan;
+    int refCount;  // IOCs attached to the segment, -1 once it is being removed
+} ADScanPBSharedHeader_t;
+
+// Frames, timestamps and shape of a loaded scan. The image data and timestamps are either heap
+// buffers, or point into a memory mapped cache file or shared memory segment.
+typedef struct ADScanPBScanBuffer {
+    void *imageData = NULL;
+    void *timestampData = NULL;
+    int numTimestamps = 0;
+    size_t frameSizeBytes = 0;  // Size of a single frame in bytes
+
+    void *mapping = NULL;
+    size_t mappingSize = 0;
+
+    // Set if the scan is shared with other IOCs, through a writable mapping of the segment header
+    ADScanPBSharedHeader_t *sharedHeader = NULL;
+    size_t sharedHeaderSize = 0;
+    string sharedSegmentName;
+
+    int numFrames = 0;
+    int sizeX = 0;
+    int sizeY = 0;
+    int dataType = NDUInt8;
+    int colorMode = NDColorModeMono;
+    char scanID[256] = "";
+
+    // Frames of the source scan that were loaded. Frame i of the buffer is source frame
+    // sourceFirstFrame + i * sourceFrameStride.
+    int sourceFirstFrame = 0;
+    int sourceFrameStride = 1;
+
+    // Playlist entry the scan was loaded for, -1 if loaded directly, and the number of passes it
+    // is played for
+    int playlistEntry = -1;
+    int repeat = 1;
+} ADScanPBScanBuffer_t;
+
+// Single scan of a playlist. Data source fields left out of the playlist take the value of the
+// matching PV, and the whole scan is loaded unless frames are selected.
+typedef struct ADScanPBPlaylistEntry {
+    int dataSource;
+    string path;
+    string scanID;
+    string imageDataset;
+    string tsDataset;
+    int firstFrame;
+    int lastFrame;  // -1 for the last frame of the scan
+    int frameStride;
+    int repeat;     // Number of passes through the frames before moving on to the next entry
+} ADScanPBPlaylistEntry_t;
+
+/*
+ * NDArray pool used for zero-copy playback. Arrays allocated from it reference frames in the
+ * scan buffer directly, so the data pointer is detached when the last reference is released to
+ * ensure the pool never frees or reuses scan memory. Also tracks how many such arrays are still
+ * held downstream, since the scan buffer must outlive all of them.
+ */
+class ADScanPBArrayPool : public NDArrayPool {
+   public:
+    ADScanPBArrayPool(asynNDArrayDriver *pDriver) : NDArrayPool(pDriver, 0) {}
+    int getNumOutstanding() { return this->numOutstanding; }
+
+   protected:
+    virtual void onAllocateArray(NDArray *pArray);
+    virtual void onReleaseArray(NDArray *pArray);
+
+   private:
+    std::atomic<int> numOutstanding{0};
+};
+
 /*
  * Class definition of the ADScanPB driver. It inherits from the base ADDriver class
  *
@@ -142,6 +430,10 @@ class ADScanPB : ADDriver {
     ~ADScanPB();
 
     void playbackThread();
+    void prefetchThread();
+    void loaderThread();
+    void pipelineThread();
+    void playlistThread();
 
    protected:
     int ADScanPB_PlaybackRateFPS;
@@ -171,7 +463,86 @@ class ADScanPB : ADDriver {
     int ADScanPB_ReadySignal;
     int ADScanPB_NumTrigsRecd;
     int ADScanPB_NumTrigsDropped;
-#define ADSCANPB_LAST_PARAM ADScanPB_NumTrigsDropped
+    int ADScanPB_StorageMode;
+    int ADScanPB_PrefetchDepth;
+    int ADScanPB_PrefetchLevel;
+    int ADScanPB_StreamStalls;
+    int ADScanPB_MeasuredFPS;
+    int ADScanPB_TiledConcurrency;
+    int ADScanPB_LoadState;
+    int ADScanPB_CancelLoad;
+    int ADScanPB_ProgressivePlayback;
+    int ADScanPB_ProgressiveMinFrames;
+    int ADScanPB_CacheEnable;
+    int ADScanPB_CacheDir;
+    int ADScanPB_CacheMaxSize;
+    int ADScanPB_CacheSize;
+    int ADScanPB_CacheHits;
+    int ADScanPB_CacheMisses;
+    int ADScanPB_ZeroCopy;
+    int ADScanPB_ZeroCopyOutstanding;
+    int ADScanPB_PacingSpinTail;
+    int ADScanPB_PacingLateness;
+    int ADScanPB_PacingJitter;
+    int ADScanPB_PlaybackTiming;
+    int ADScanPB_PlaybackSpeed;
+    int ADScanPB_MaxGap;
+    int ADScanPB_PipelineDepth;
+    int ADScanPB_PipelineOccupancy;
+    int ADScanPB_PipelineStalls;
+    int ADScanPB_BurstFrames;
+    int ADScanPB_BurstDuration;
+    int ADScanPB_MeasuredGBps;
+    int ADScanPB_AllocFailures;
+    int ADScanPB_KernelTime;
+    int ADScanPB_KernelGBps;
+    int ADScanPB_OutputDataType;
+    int ADScanPB_ConvertScale;
+    int ADScanPB_ConvertOffset;
+    int ADScanPB_CompressCodec;
+    int ADScanPB_CompressLevel;
+    int ADScanPB_DecompressThreads;
+    int ADScanPB_CompressionRatio;
+    int ADScanPB_DecompressGBps;
+    int ADScanPB_DecompressFPS;
+    int ADScanPB_DecompressKeepingUp;
+    int ADScanPB_EmitCompressed;
+    int ADScanPB_LoadThreads;
+    int ADScanPB_SharedMemory;
+    int ADScanPB_SharedAttached;
+    int ADScanPB_SharedUsers;
+    int ADScanPB_NextScanID;
+    int ADScanPB_NextScanReady;
+    int ADScanPB_SwapScan;
+    int ADScanPB_AutoSwap;
+    int ADScanPB_Playlist;
+    int ADScanPB_PlaylistFile;
+    int ADScanPB_PlaylistEnable;
+    int ADScanPB_PlaylistLoop;
+    int ADScanPB_PlaylistLength;
+    int ADScanPB_PlaylistIndex;
+    int ADScanPB_PlaylistPass;
+    int ADScanPB_PlaylistUnderruns;
+    int ADScanPB_FirstFrame;
+    int ADScanPB_LastFrame;
+    int ADScanPB_FrameStride;
+    int ADScanPB_TiledRequests;
+    int ADScanPB_TiledConnections;
+    int ADScanPB_TiledRequestTime;
+    int ADScanPB_TiledEncoding;
+    int ADScanPB_TiledWireMB;
+    int ADScanPB_TiledDecodedMB;
+    int ADScanPB_TiledCacheMaxSize;
+    int ADScanPB_TiledCacheSize;
+    int ADScanPB_TiledPrefetchTime;
+    int ADScanPB_TiledCacheHitRate;
+    int ADScanPB_TiledPrefetchLead;
+    int ADScanPB_TiledMinX;
+    int ADScanPB_TiledMinY;
+    int ADScanPB_TiledSizeX;
+    int ADScanPB_TiledSizeY;
+    int ADScanPB_TiledRequestSize;
+#define ADSCANPB_LAST_PARAM ADScanPB_TiledRequestSize
 
    private:
     // Some data variables
@@ -181,13 +552,152 @@ class ADScanPB : ADDriver {
 
     char* tiledApiKey;
 
-    void *scanImageDataBuffer;
-    void *scanTimestampDataBuffer;
+    // Tiled HTTP sessions, kept for the lifetime of the driver so that their connections are
+    // reused between requests and between scan loads. Idle sessions are guarded by
+    // tiledSessionMutex, and share DNS and TLS session caches through tiledShare.
+    vector<cpr::Session *> tiledSessions;
+    epicsMutexId tiledSessionMutex;
+    CURLSH *tiledShare = NULL;
+    epicsMutexId tiledShareMutex;
+
+    // Tiled requests made and connections opened since the driver started, and the time spent
+    // in requests and the bytes received and decoded during the current load
+    std::atomic<int> tiledRequests{0};
+    std::atomic<int> tiledConnections{0};
+    std::atomic<int> tiledLoadRequests{0};
+    std::atomic<epicsUInt64> tiledLoadRequestTimeUs{0};
+    std::atomic<epicsUInt64> tiledLoadWireBytes{0};
+    std::atomic<epicsUInt64> tiledLoadDecodedBytes{0};
+
+    // Scans are double buffered. The active scan is played back, while the next scan is loaded in
+    // the background and swapped in at a frame boundary. Loaders fill in the load target, which is
+    // the active scan unless the next scan is being preloaded. The swap is guarded by
+    // scanSwapMutex.
+    ADScanPBScanBuffer_t scanBuffers[2];
+    ADScanPBScanBuffer_t *scan = &scanBuffers[0];
+    ADScanPBScanBuffer_t *nextScan = &scanBuffers[1];
+    ADScanPBScanBuffer_t *loadTarget = &scanBuffers[0];
+    std::atomic<bool> nextScanReady{false};
+    std::atomic<bool> swapRequested{false};
+    epicsMutexId scanSwapMutex;
+
+    // The HDF5 library is not thread safe, and is called from the loader, the chunk workers and
+    // the streaming reader, so every call into it is made holding h5Mutex
+    std::mutex h5Mutex;
+
+    // Playlist state. The playlist thread preloads the entry after the active one whenever a load
+    // finishes or a scan is swapped in, and the playback thread swaps it in once the active entry
+    // has been played the requested number of times. playlistCursor is the last entry that was
+    // loaded or attempted, and playlistNextEntry the entry being preloaded or ready, or -1 at the
+    // end of the playlist.
+    std::vector<ADScanPBPlaylistEntry_t> playlist;
+    std::atomic<bool> playlistActive{false};
+    int playlistCursor = -1;
+    std::atomic<int> playlistNextEntry{-1};
+    int playlistFailures = 0;
+    std::atomic<int> playlistUnderruns{0};
+    bool playlistThreadRunning = true;
+    epicsThreadId playlistThreadId;
+    epicsEventId playlistEventId;
+
+    // Pool for arrays that reference the scan buffer directly rather than a copy of it
+    ADScanPBArrayPool *zeroCopyPool;
 
     bool playback = false;
 
+    // Position written while playing back, picked up by the playback thread before the next frame
+    std::atomic<int> playbackPosRequest{-1};
+
     epicsThreadId playbackThreadId;
 
+    // Streaming playback state. File and dataset stay open for the lifetime of the scan.
+    hid_t streamFileId = -1;
+    hid_t streamDatasetId = -1;
+    hid_t streamDtypeId = -1;
+    int streamNumFrames = 0;
+
+    ADScanPBRingSlot_t *prefetchRing = NULL;
+    void *prefetchRingBuffer = NULL;
+    int prefetchRingDepth = 0;
+    int prefetchTarget = 0;  // Next frame the playback thread will request
+    int prefetchStalls = 0;  // Number of frames playback had to wait on the reader for
+    bool prefetching = false;
+    epicsMutexId prefetchMutex;
+    epicsEventId prefetchWakeEventId;
+    epicsEventId prefetchFrameReadyEventId;
+    std::vector<epicsThreadId> prefetchThreadIds;
+
+    // Tiled streaming state. The prefetch threads fetch whole blocks on demand, and hold them in
+    // a memory bounded LRU cache guarded by tiledStreamMutex. Blocks are indexed by their
+    // position in the source array, and are NULL until fetched.
+    bool tiledStreaming = false;
+    std::atomic<bool> tiledStreamStop{false};
+    string tiledStreamURL;
+    cpr::Header tiledStreamHeader;
+    int tiledStreamEncoding = ADSCANPB_TILED_ENCODING_NONE;
+    int tiledStreamConcurrency = 1;  // Workers fetching the tiles of a block
+    string tiledStreamSlice;  // Region of interest sliced from each frame, empty to fetch blocks
+    bool tiledStreamByteSwap = false;
+    size_t tiledStreamBytesPerElem = 1;
+    std::vector<size_t> tiledBlockStarts;  // First source frame of each block, then the total
+    std::vector<size_t> tiledRowStarts;    // First row of each tile of a block, then the height
+    std::vector<size_t> tiledColStarts;    // First column of each tile of a block, then the width
+    std::vector<ADScanPBTiledBlock_t *> tiledBlocks;
+    size_t tiledCacheBytes = 0;
+    size_t tiledCacheMaxBytes = 0;
+    std::atomic<double> tiledPrefetchTime{0};
+    epicsUInt64 tiledUseCounter = 0;
+    int tiledCacheHits = 0;
+    int tiledCacheMisses = 0;
+    int tiledReadAheads = 0;  // Readers fetching blocks ahead rather than filling the ring
+    epicsMutexId tiledStreamMutex;
+    epicsEventId tiledBlockReadyEventId;
+
+    // Rate frames are being played back at, set by the playback thread to size the read-ahead
+    std::atomic<double> streamRateFPS{0};
+
+    // Compressed storage state, an index of the compressed frames in the scan
+    ADScanPBCompressedFrame_t *compressedFrames = NULL;
+    std::atomic<size_t> compressedBytes{0};
+    int compressCodec = ADSCANPB_CODEC_LZ4;
+    int compressLevel = 5;
+    size_t compressTypeSize = 1;
+    ADScanPBStoreCodec_t storeCodec = {NDCODEC_NONE, 0, 0, 0};
+    // Store holds chunks read directly from the scan file, which can only be emitted compressed
+    bool storeIsPassthrough = false;
+
+    // Time spent decompressing frames into the prefetch ring, since last published
+    std::atomic<epicsUInt64> decompressTimeNs{0};
+    std::atomic<int> decompressFrames{0};
+
+    // Copy-ahead pipeline state. The generation and next frame are guarded by prefetchMutex.
+    epicsMessageQueueId pipelineQueue = NULL;
+    epicsThreadId pipelineThreadId;
+    ADScanPBFrameFormat_t pipelineFormat;
+    int pipelineNumFrames = 0;
+    int pipelineNextFrame = 0;
+    std::atomic<int> pipelineGeneration{0};
+    int pipelineStalls = 0;
+    std::atomic<bool> pipelineRunning{false};
+
+    // Frames the array pool could not allocate during the current acquisition
+    std::atomic<int> allocFailures{0};
+
+    // Time spent copying frames out of the scan buffer, since last published
+    std::atomic<epicsUInt64> kernelTimeNs{0};
+    std::atomic<epicsUInt64> kernelBytes{0};
+    std::atomic<int> kernelFrames{0};
+
+    // Background scan loading state. loadedFrontier is the number of frames, counted from the
+    // start of the scan, that are resident and may be played back while the load continues.
+    char loadingScanID[256];
+    std::atomic<bool> loading{false};
+    std::atomic<bool> loadCancelRequested{false};
+    std::atomic<int> loadedFrontier{0};
+    bool loaderThreadActive = false;
+    epicsThreadId loaderThreadId;
+    epicsEventId loadProgressEventId;
+
     // ----------------------------------------
     // ScanPB Functions - Logging/Reporting
     //-----------------------------------------
@@ -209,11 +719,115 @@ class ADScanPB : ADDriver {
     // asynStatus openScanMP4(const char *filePath);
 
     asynStatus openScanTiled(const char *nodePath);
+    asynStatus downloadTiledBlock(cpr::Session *session, const string &url,
+                                  const cpr::Header &header, int encoding, void *dest,
+                                  size_t expectedBytes, const std::atomic<bool> &cancel,
+                                  string &errorMsg);
+    cpr::Session *acquireTiledSession();
+    void releaseTiledSession(cpr::Session *session);
+    void recordTiledRequest(cpr::Session *session, const cpr::Response &response);
+    void publishTiledStats();
 
     void closeScan();
+    void releaseScanStorage();
+    void freeScanBuffer(ADScanPBScanBuffer_t *buffer);
+    void setScanShape(int numFrames, int sizeX, int sizeY, int colorMode, int dataType);
+    asynStatus selectFrames(int datasetFrames, int *numSelected);
+    void publishScanShape(bool resetSize);
+
+    asynStatus startLoad(const char *scanID);
+    void launchLoader(const char *scanID);
+    void cancelLoad();
+    void advanceLoadedFrontier(int frontier);
+
+    // ----------------------------------------
+    // ScanPB Functions - Next Scan Preloading
+    //-----------------------------------------
+
+    asynStatus startPreload(const char *scanID);
+    bool swapNextScan();
+
+    // ----------------------------------------
+    // ScanPB Functions - Scan Playlist
+    //-----------------------------------------
+
+    asynStatus parsePlaylist(const string &text);
+    asynStatus readPlaylistFile(const char *filePath);
+    asynStatus startPlaylist();
+    void stopPlaylist();
+    asynStatus loadPlaylistEntry(int index, bool preload);
+    void advancePlaylist();
+    bool playlistEntryDone(int passes);
+    bool continuePlayback(int autoRepeat, int autoSwap, int passes);
+
+    // ----------------------------------------
+    // ScanPB Functions - Local Scan Cache
+    //-----------------------------------------
+
+    string buildScanKey(const char *scanID);
+    string buildCacheKey(const char *scanID);
+    string getCacheFilePath(const string &key);
+    void fillCacheHeader(ADScanPBCacheHeader_t *header, const string &key, size_t headerSize);
+    asynStatus openScanCache(const string &key);
+    void writeScanCache(const string &key);
+    void evictScanCache(const string &keepPath);
+
+    // ----------------------------------------
+    // ScanPB Functions - Shared Memory Scan Store
+    //-----------------------------------------
+
+    string getSharedSegmentName(const string &key);
+    asynStatus attachSharedScan(const string &key, bool addReference);
+    void publishSharedScan(const string &key);
+    void detachSharedScan(ADScanPBScanBuffer_t *buffer);
+
+    // ----------------------------------------
+    // ScanPB Functions - Streaming Playback
+    //-----------------------------------------
+
+    asynStatus startPrefetch(int depth, int numThreads);
+    void stopPrefetch();
+    asynStatus readFrameHDF5(int frame, void *dest);
+    asynStatus readFrameTiled(int frame, void *dest);
+    int getTiledBlock(int frame);
+    size_t getTiledBlockFrames(int block);
+    asynStatus fetchTiledStreamBlock(int block);
+    bool prefetchTiledBlock(int target);
+    void publishTiledStreamStats(int target);
+    void stopTiledStream();
+    asynStatus readFrame(int frame, void *dest);
+    int getStorageMode();
+    asynStatus startCompressedStore(int numFrames);
+    asynStatus compressFrames(int firstFrame, int numFrames, const void *src, int numThreads);
+    asynStatus decompressFrame(int frame, void *dest);
+    void freeCompressedStore();
+    asynStatus loadChunksHDF5(hid_t datasetId, int numFrames, int ndims);
+    asynStatus readChunksParallelHDF5(hid_t datasetId, const ADScanPBChunkLayout_t &layout);
+    NDArray *prepareCompressedFrame(int frame, const ADScanPBFrameFormat_t &format);
+    void publishDecompressStats(double targetFPS);
+
+    // Returns pointer to frame data for playback, must be paired with releaseFrame
+    const void *acquireFrame(int frame);
+    void releaseFrame(int frame);
 
     void setPlaybackRate(int rateFormat);
 
+    // ----------------------------------------
+    // ScanPB Functions - Frame Pipeline
+    //-----------------------------------------
+
+    void getFrameFormat(ADScanPBFrameFormat_t *format);
+    NDArray *prepareFrame(int frame, const ADScanPBFrameFormat_t &format);
+    void addSourceFrameAttribute(NDArray *pArray, int frame);
+    void publishKernelStats();
+    void startPipeline(int depth, const ADScanPBFrameFormat_t &format, int startFrame,
+                       int numFrames);
+    void stopPipeline();
+    NDArray *receivePipelineFrame(int frame);
+
+    epicsUInt64 getFramePeriodNs(int frame, int previousFrame, double spf);
+    void waitForDeadline(epicsUInt64 deadline, epicsUInt64 spinTailNs);
+
     // function that begins image aquisition
     asynStatus acquireStart();
 
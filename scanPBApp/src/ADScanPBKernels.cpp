@@ -0,0 +1,280 @@
+/**
+ * Frame kernels for the ADScanPB EPICS driver
+ *
+ * The kernels work a row at a time with contiguous inner loops over plain arrays, so the
+ * compiler can vectorize them for whichever instruction set the IOC is built for. Each pair of
+ * input and output types gets its own instantiation, so there is no per-pixel type dispatch.
+ *
+ * Author: Jakub Wlodek
+ *
+ * Copyright (c) : Brookhaven National Laboratory, 2023
+ *
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <epicsTypes.h>
+
+#include "ADScanPBKernels.h"
+
+bool scanPBGeometryIsIdentity(const ADScanPBGeometry_t &geometry) {
+    return geometry.minX == 0 && geometry.minY == 0 && geometry.sizeX == geometry.srcSizeX &&
+           geometry.sizeY == geometry.srcSizeY && geometry.binX == 1 && geometry.binY == 1 &&
+           !geometry.reverseX && !geometry.reverseY;
+}
+
+size_t scanPBBytesPerElement(NDDataType_t dataType) {
+    switch (dataType) {
+        case NDInt8:
+        case NDUInt8:
+            return 1;
+        case NDInt16:
+        case NDUInt16:
+            return 2;
+        case NDInt32:
+        case NDUInt32:
+        case NDFloat32:
+            return 4;
+        default:
+            return 8;
+    }
+}
+
+/**
+ * @brief Narrows a scaled value to the output type, clamping it to the range of integer types
+ * rather than letting it wrap. NaN converts to 0 for integer types.
+ */
+template <typename Out>
+static inline Out saturateCast(double value) {
+    if (!std::numeric_limits<Out>::is_integer) return (Out)value;
+    if (!(value == value)) return 0;
+    const Out lowest = std::numeric_limits<Out>::lowest();
+    const Out highest = std::numeric_limits<Out>::max();
+    if (value <= (double)lowest) return lowest;
+    if (value >= (double)highest) return highest;
+    return (Out)value;
+}
+
+/**
+ * @brief Crops and flips a frame without binning, converting each value to the output type.
+ * Rows that need no conversion are copied whole, or reversed pixel by pixel when flipping in X,
+ * keeping the components of each pixel in order.
+ */
+template <typename In, typename Out>
+static void cropFrame(const In *src, Out *dst, const ADScanPBGeometry_t &g,
+                      const ADScanPBConversion_t &conv) {
+    const size_t c = g.components;
+    const size_t srcRowLen = g.srcSizeX * c;
+    const size_t outRowLen = g.sizeX * c;
+    const bool scaled = conv.scale != 1.0 || conv.offset != 0.0;
+    const bool plainCopy = std::is_same<In, Out>::value && !scaled;
+
+    for (size_t y = 0; y < g.sizeY; y++) {
+        const In *in = src + (g.minY + y) * srcRowLen + g.minX * c;
+        Out *out = dst + (g.reverseY ? g.sizeY - 1 - y : y) * outRowLen;
+
+        if (plainCopy && !g.reverseX) {
+            memcpy(out, in, outRowLen * sizeof(Out));
+        } else if (plainCopy && c == 1) {
+            std::reverse_copy(in, in + outRowLen, out);
+        } else if (plainCopy) {
+            for (size_t x = 0; x < g.sizeX; x++)
+                std::copy(in + x * c, in + (x + 1) * c, out + (g.sizeX - 1 - x) * c);
+        } else if (!g.reverseX) {
+            for (size_t i = 0; i < outRowLen; i++)
+                out[i] = saturateCast<Out>(in[i] * conv.scale + conv.offset);
+        } else {
+            for (size_t x = 0; x < g.sizeX; x++)
+                for (size_t k = 0; k < c; k++)
+                    out[(g.sizeX - 1 - x) * c + k] =
+                        saturateCast<Out>(in[x * c + k] * conv.scale + conv.offset);
+        }
+    }
+}
+
+/**
+ * @brief Crops, bins and flips a frame, converting each binned value to the output type. Each
+ * output row is formed by first summing binY source rows into a row of accumulators, then
+ * summing binX neighbouring accumulators per pixel. Sums use the wider type Acc and saturate when
+ * narrowed to the output type.
+ */
+template <typename In, typename Out, typename Acc>
+static void binFrame(const In *src, Out *dst, const ADScanPBGeometry_t &g,
+                     const ADScanPBConversion_t &conv) {
+    const size_t c = g.components;
+    const size_t srcRowLen = g.srcSizeX * c;
+    const size_t regionRowLen = g.sizeX * c;
+    const size_t outX = g.sizeX / g.binX;
+    const size_t outY = g.sizeY / g.binY;
+    const size_t outRowLen = outX * c;
+    const bool scaled = conv.scale != 1.0 || conv.offset != 0.0;
+    const bool sameType = std::is_same<In, Out>::value && !scaled;
+    const Acc lowest = (Acc)std::numeric_limits<In>::lowest();
+    const Acc highest = (Acc)std::numeric_limits<In>::max();
+
+    // Reused between frames to avoid an allocation per frame
+    static thread_local std::vector<Acc> rowSums;
+    rowSums.resize(regionRowLen);
+    Acc *sums = rowSums.data();
+
+    for (size_t y = 0; y < outY; y++) {
+        std::fill(sums, sums + regionRowLen, (Acc)0);
+        for (size_t by = 0; by < g.binY; by++) {
+            const In *in = src + (g.minY + y * g.binY + by) * srcRowLen + g.minX * c;
+            for (size_t i = 0; i < regionRowLen; i++) sums[i] += in[i];
+        }
+
+        Out *out = dst + (g.reverseY ? outY - 1 - y : y) * outRowLen;
+        for (size_t x = 0; x < outX; x++) {
+            size_t outPixel = g.reverseX ? outX - 1 - x : x;
+            for (size_t k = 0; k < c; k++) {
+                Acc sum = 0;
+                for (size_t bx = 0; bx < g.binX; bx++) sum += sums[(x * g.binX + bx) * c + k];
+                if (sameType)
+                    out[outPixel * c + k] = (Out)std::min(std::max(sum, lowest), highest);
+                else
+                    out[outPixel * c + k] =
+                        saturateCast<Out>((double)sum * conv.scale + conv.offset);
+            }
+        }
+    }
+}
+
+template <typename In, typename Out, typename Acc>
+static void transformFrame(const void *src, void *dst, const ADScanPBGeometry_t &geometry,
+                           const ADScanPBConversion_t &conversion) {
+    if (geometry.binX == 1 && geometry.binY == 1)
+        cropFrame<In, Out>((const In *)src, (Out *)dst, geometry, conversion);
+    else
+        binFrame<In, Out, Acc>((const In *)src, (Out *)dst, geometry, conversion);
+}
+
+template <typename In, typename Acc>
+static int transformFrameFrom(const void *src, void *dst, const ADScanPBGeometry_t &geometry,
+                              const ADScanPBConversion_t &conversion) {
+    switch (conversion.dataType) {
+        case NDInt8:
+            transformFrame<In, epicsInt8, Acc>(src, dst, geometry, conversion);
+            break;
+        case NDUInt8:
+            transformFrame<In, epicsUInt8, Acc>(src, dst, geometry, conversion);
+            break;
+        case NDInt16:
+            transformFrame<In, epicsInt16, Acc>(src, dst, geometry, conversion);
+            break;
+        case NDUInt16:
+            transformFrame<In, epicsUInt16, Acc>(src, dst, geometry, conversion);
+            break;
+        case NDInt32:
+            transformFrame<In, epicsInt32, Acc>(src, dst, geometry, conversion);
+            break;
+        case NDUInt32:
+            transformFrame<In, epicsUInt32, Acc>(src, dst, geometry, conversion);
+            break;
+        case NDInt64:
+            transformFrame<In, epicsInt64, Acc>(src, dst, geometry, conversion);
+            break;
+        case NDUInt64:
+            transformFrame<In, epicsUInt64, Acc>(src, dst, geometry, conversion);
+            break;
+        case NDFloat32:
+            transformFrame<In, epicsFloat32, Acc>(src, dst, geometry, conversion);
+            break;
+        case NDFloat64:
+            transformFrame<In, epicsFloat64, Acc>(src, dst, geometry, conversion);
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+// Integers are binned in 64 bit accumulators, so a bin of any frame size cannot overflow them;
+// 64 bit integers are accumulated in their own type, and wrap rather than saturate
+int scanPBTransformFrame(const void *src, NDDataType_t srcDataType, void *dst,
+                         const ADScanPBGeometry_t &geometry,
+                         const ADScanPBConversion_t &conversion) {
+    switch (srcDataType) {
+        case NDInt8:
+            return transformFrameFrom<epicsInt8, epicsInt64>(src, dst, geometry, conversion);
+        case NDUInt8:
+            return transformFrameFrom<epicsUInt8, epicsUInt64>(src, dst, geometry, conversion);
+        case NDInt16:
+            return transformFrameFrom<epicsInt16, epicsInt64>(src, dst, geometry, conversion);
+        case NDUInt16:
+            return transformFrameFrom<epicsUInt16, epicsUInt64>(src, dst, geometry, conversion);
+        case NDInt32:
+            return transformFrameFrom<epicsInt32, epicsInt64>(src, dst, geometry, conversion);
+        case NDUInt32:
+            return transformFrameFrom<epicsUInt32, epicsUInt64>(src, dst, geometry, conversion);
+        case NDInt64:
+            return transformFrameFrom<epicsInt64, epicsInt64>(src, dst, geometry, conversion);
+        case NDUInt64:
+            return transformFrameFrom<epicsUInt64, epicsUInt64>(src, dst, geometry, conversion);
+        case NDFloat32:
+            return transformFrameFrom<epicsFloat32, epicsFloat64>(src, dst, geometry, conversion);
+        case NDFloat64:
+            return transformFrameFrom<epicsFloat64, epicsFloat64>(src, dst, geometry, conversion);
+        default:
+            return -1;
+    }
+}
+
+template <typename T>
+static void byteSwap(T *data, size_t numElements) {
+    for (size_t i = 0; i < numElements; i++) {
+        T value = data[i];
+        T swapped = 0;
+        for (size_t b = 0; b < sizeof(T); b++) {
+            swapped = (T)((swapped << 8) | (value & 0xff));
+            value = (T)(value >> 8);
+        }
+        data[i] = swapped;
+    }
+}
+
+int scanPBByteSwap(void *data, size_t numElements, size_t bytesPerElement) {
+    switch (bytesPerElement) {
+        case 1:
+            break;
+        case 2:
+            byteSwap((epicsUInt16 *)data, numElements);
+            break;
+        case 4:
+            byteSwap((epicsUInt32 *)data, numElements);
+            break;
+        case 8:
+            byteSwap((epicsUInt64 *)data, numElements);
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+void scanPBByteUnshuffle(const void *src, void *dst, size_t numElements, size_t bytesPerElement) {
+    const epicsUInt8 *in = (const epicsUInt8 *)src;
+    epicsUInt8 *out = (epicsUInt8 *)dst;
+    for (size_t b = 0; b < bytesPerElement; b++) {
+        const epicsUInt8 *plane = in + b * numElements;
+        for (size_t i = 0; i < numElements; i++) out[i * bytesPerElement + b] = plane[i];
+    }
+}
+
+void scanPBCopyTile(const void *tile, void *frame, size_t rows, size_t cols, size_t minRow,
+                    size_t minCol, size_t frameCols, size_t bytesPerElement) {
+    const epicsUInt8 *in = (const epicsUInt8 *)tile;
+    epicsUInt8 *out = (epicsUInt8 *)frame + (minRow * frameCols + minCol) * bytesPerElement;
+    size_t rowBytes = cols * bytesPerElement;
+    if (cols == frameCols) {
+        memcpy(out, in, rows * rowBytes);
+        return;
+    }
+    for (size_t y = 0; y < rows; y++)
+        memcpy(out + y * frameCols * bytesPerElement, in + y * rowBytes, rowBytes);
+}
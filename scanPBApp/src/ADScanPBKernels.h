@@ -0,0 +1,116 @@
+/*
+ * Header file for the ADScanPB frame kernels
+ *
+ * These kernels transform frames as they are copied out of the scan buffer, so that a frame is
+ * only read and written once on its way into an NDArray.
+ *
+ * Author: Jakub Wlodek
+ *
+ * Copyright (c) : Brookhaven National Laboratory, 2023
+ *
+ */
+
+// header guard
+#ifndef ADSCANPB_KERNELS_H
+#define ADSCANPB_KERNELS_H
+
+#include <stddef.h>
+
+#include "NDArray.h"
+
+// Region of a source frame to emit and how to transform it, mirroring the ADBase geometry
+// params. The region is given in unbinned source pixels, and its size is a multiple of the
+// binning.
+typedef struct ADScanPBGeometry {
+    size_t srcSizeX;
+    size_t srcSizeY;
+    size_t components;  // Values per pixel, 1 for mono and 3 for RGB1
+    size_t minX;
+    size_t minY;
+    size_t sizeX;
+    size_t sizeY;
+    size_t binX;
+    size_t binY;
+    bool reverseX;
+    bool reverseY;
+} ADScanPBGeometry_t;
+
+// Data type frames are converted to as they are copied, with an optional linear scaling
+typedef struct ADScanPBConversion {
+    NDDataType_t dataType;
+    double scale;
+    double offset;
+} ADScanPBConversion_t;
+
+/**
+ * @brief Checks whether a geometry leaves frames untouched, in which case a plain copy suffices
+ *
+ * @param geometry Geometry to check
+ * @return true if the geometry is the full, unbinned and unreversed frame
+ */
+bool scanPBGeometryIsIdentity(const ADScanPBGeometry_t &geometry);
+
+/**
+ * @brief Crops, bins, flips and converts a frame in a single pass. Binned pixels are summed,
+ * saturating at the limits of the data type, as with on-chip binning. When converting, each
+ * output value is the (binned) input value times the scale plus the offset, saturated to the
+ * range of the output type.
+ *
+ * @param src Start of the source frame
+ * @param srcDataType Data type of the source frame, any NDDataType_t
+ * @param dst Destination, sizeX / binX by sizeY / binY pixels of the conversion data type
+ * @param geometry Region and transform to apply
+ * @param conversion Output data type, scale and offset
+ * @return 0 on success, -1 if a data type is not supported
+ */
+int scanPBTransformFrame(const void *src, NDDataType_t srcDataType, void *dst,
+                         const ADScanPBGeometry_t &geometry,
+                         const ADScanPBConversion_t &conversion);
+
+/**
+ * @brief Gets the size of a single element of a data type
+ *
+ * @param dataType Any NDDataType_t
+ * @return Size in bytes
+ */
+size_t scanPBBytesPerElement(NDDataType_t dataType);
+
+/**
+ * @brief Reverses the byte order of each element of a buffer in place, for data stored with the
+ * opposite endianness to the host.
+ *
+ * @param data Buffer to swap
+ * @param numElements Number of elements in the buffer
+ * @param bytesPerElement Size of each element, 1, 2, 4 or 8 bytes
+ * @return 0 on success, -1 if the element size is not supported
+ */
+int scanPBByteSwap(void *data, size_t numElements, size_t bytesPerElement);
+
+/**
+ * @brief Reverses the HDF5 shuffle filter, which stores the first byte of every element, then
+ * the second byte of every element, and so on.
+ *
+ * @param src Shuffled buffer
+ * @param dst Buffer of the same size to write the unshuffled elements to
+ * @param numElements Number of elements in the buffer
+ * @param bytesPerElement Size of each element
+ */
+void scanPBByteUnshuffle(const void *src, void *dst, size_t numElements, size_t bytesPerElement);
+
+/**
+ * @brief Copies a tile of a frame, as stored in an array chunked along Y and X, into its region
+ * of the full frame. Tiles spanning the full width are copied in one go, others row by row.
+ *
+ * @param tile Start of the tile, rows by cols elements
+ * @param frame Start of the full frame, frameCols elements wide
+ * @param rows Height of the tile
+ * @param cols Width of the tile
+ * @param minRow First row of the frame the tile covers
+ * @param minCol First column of the frame the tile covers
+ * @param frameCols Width of the full frame
+ * @param bytesPerElement Size of each element
+ */
+void scanPBCopyTile(const void *tile, void *frame, size_t rows, size_t cols, size_t minRow,
+                    size_t minCol, size_t frameCols, size_t bytesPerElement);
+
+#endif